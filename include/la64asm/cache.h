@@ -0,0 +1,41 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2024 cr4zyengineer
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef LA64ASM_CACHE_H
+#define LA64ASM_CACHE_H
+
+#include <la64asm/type.h>
+
+/*
+ * files and their tokenized lines kept between invocations, a file is only
+ * read and tokenized again once it was marked stale
+ */
+compiler_cache_file_t *cache_file(compiler_cache_t *cc, const char *real);
+void cache_file_store(compiler_cache_file_t *cf, const char *code, size_t len);
+void cache_file_store_lines(compiler_cache_file_t *cf, compiler_line_t *line, uint64_t line_cnt);
+bool cache_mark_stale(compiler_cache_t *cc, const char *real);
+void cache_prune(compiler_cache_t *cc);
+void cache_free(compiler_cache_t *cc);
+
+#endif /* LA64ASM_CACHE_H */
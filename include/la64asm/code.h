@@ -26,10 +26,27 @@
 #define COMPILER_CODE_H
 
 #include <stdlib.h>
+#include <stdbool.h>
 #include <la64asm/type.h>
 
+bool code_dep_add(compiler_invocation_t *ci, const char *path);
+char *code_include_path(const char *from, const char *path, size_t len);
 void get_code_buffer(const char **files, int file_cnt, compiler_invocation_t *ci);
 void code_tokengen(compiler_invocation_t *ci);
+void code_line_relink(compiler_invocation_t *ci);
+void code_line_copy(compiler_line_t *dst, compiler_line_t *src);
+void code_line_free(compiler_line_t *cl);
+void code_resource_hold(compiler_invocation_t *ci, void *ptr, compiler_release_t release);
+void code_resource_drop(compiler_invocation_t *ci, void *ptr);
+void code_resource_keep(compiler_invocation_t *ci, void *ptr);
+void code_release_file(void *fp);
+reloc_table_entry *code_reloc_add(compiler_invocation_t *ci);
+void code_image_align(compiler_invocation_t *ci, compiler_token_t *ct, uint64_t align, uint8_t fill);
+bool code_token_align_value(compiler_line_t *cl, uint64_t *align);
+bool code_token_align(compiler_line_t *cl, uint8_t fill);
 void code_binary_spitout(compiler_invocation_t *ci);
+void code_depfile_spitout(compiler_invocation_t *ci);
+void code_map_spitout(compiler_invocation_t *ci);
+void code_debuginfo_spitout(compiler_invocation_t *ci);
 
 #endif /* COMPILER_CODE_H */
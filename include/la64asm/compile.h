@@ -27,6 +27,10 @@
 
 #include <la64asm/type.h>
 
-void compile_files(const char **files, int file_cnt);
+compiler_invocation_t *compiler_invocation_alloc(const compiler_options_t *opt);
+void compiler_invocation_reset(compiler_invocation_t *ci, const compiler_options_t *opt);
+void compiler_invocation_dealloc(compiler_invocation_t *ci);
+void compile_invocation(compiler_invocation_t *ci, const char **files, int file_cnt);
+void compile_files(const char **files, int file_cnt, const compiler_options_t *opt);
 
 #endif /* COMPILER_COMPILE_H */
@@ -31,7 +31,12 @@
 #include <la64asm/label.h>
 #include <stdbool.h>
 
+/* encodings of one IR instruction, the template one returns 0 if no template fits */
+uint64_t la64_compiler_encode_bitwalker(compiler_invocation_t *ci, uint64_t instr, uint8_t *out, bool reloc);
+uint64_t la64_compiler_encode_template(compiler_invocation_t *ci, uint64_t instr, uint8_t *out, bool reloc);
+
 bool la64_compiler_lowcodeline(compiler_line_t *cl);
+void la64_compiler_lowsection(compiler_invocation_t *ci, uint64_t section);
 void la64_compiler_lowlevel(compiler_invocation_t *ci);
 
 #endif /* LA16_COMPILER_H */
@@ -0,0 +1,140 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2024 cr4zyengineer
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef LA64ASM_DEBUGINFO_H
+#define LA64ASM_DEBUGINFO_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+/*
+ * debug sidecar written by la64asm --debug-info, meant to be mapped as is.
+ * every table is sorted by address and every field is little endian,
+ * names are offsets into the string table.
+ */
+
+#define LA64_DEBUG_MAGIC                        "LA64DBG"
+#define LA64_DEBUG_VERSION                      1
+
+typedef struct {
+    char magic[8];                          /* LA64_DEBUG_MAGIC including its terminator */
+    uint32_t version;                       /* LA64_DEBUG_VERSION */
+    uint32_t reserved;
+    uint64_t sym_off;                       /* offset of the symbol table */
+    uint64_t sym_cnt;                       /* count of symbols */
+    uint64_t line_off;                      /* offset of the line table */
+    uint64_t line_cnt;                      /* count of lines */
+    uint64_t str_off;                       /* offset of the string table */
+    uint64_t str_size;                      /* size of the string table */
+} la64_debug_header_t;
+
+typedef struct {
+    uint64_t addr;                          /* address of the label */
+    uint32_t name;                          /* name of the label */
+    uint32_t type;                          /* nm style kind, T/t code, D data, B .bss, A absolute */
+} la64_debug_symbol_t;
+
+typedef struct {
+    uint64_t addr;                          /* first address of the line */
+    uint32_t file;                          /* path of the source file */
+    uint32_t line;                          /* line number in the source file */
+} la64_debug_line_t;
+
+static inline const la64_debug_header_t *la64_debug_open(const void *base,
+                                                         size_t size)
+{
+    const la64_debug_header_t *hdr = base;
+
+    /* the tables are bounded by dividing what is left, a sum or product of hostile counts could wrap */
+    if(size < sizeof(la64_debug_header_t) ||
+       memcmp(hdr->magic, LA64_DEBUG_MAGIC, sizeof(hdr->magic)) != 0 ||
+       hdr->version != LA64_DEBUG_VERSION ||
+       hdr->sym_off > size || hdr->sym_cnt > (size - hdr->sym_off) / sizeof(la64_debug_symbol_t) ||
+       hdr->line_off > size || hdr->line_cnt > (size - hdr->line_off) / sizeof(la64_debug_line_t) ||
+       hdr->str_off > size || hdr->str_size > size - hdr->str_off)
+    {
+        return NULL;
+    }
+
+    return hdr;
+}
+
+static inline const char *la64_debug_string(const la64_debug_header_t *hdr,
+                                            uint32_t off)
+{
+    return (off < hdr->str_size) ? (const char*)hdr + hdr->str_off + off : NULL;
+}
+
+/* both lookups return the last entry at or below addr, NULL if there is none */
+
+static inline const la64_debug_symbol_t *la64_debug_symbol_lookup(const la64_debug_header_t *hdr,
+                                                                  uint64_t addr)
+{
+    const la64_debug_symbol_t *sym = (const la64_debug_symbol_t*)((const char*)hdr + hdr->sym_off);
+    uint64_t lo = 0;
+    uint64_t hi = hdr->sym_cnt;
+
+    while(lo < hi)
+    {
+        uint64_t mid = lo + (hi - lo) / 2;
+
+        if(sym[mid].addr <= addr)
+        {
+            lo = mid + 1;
+        }
+        else
+        {
+            hi = mid;
+        }
+    }
+
+    return (lo == 0) ? NULL : &sym[lo - 1];
+}
+
+static inline const la64_debug_line_t *la64_debug_line_lookup(const la64_debug_header_t *hdr,
+                                                              uint64_t addr)
+{
+    const la64_debug_line_t *line = (const la64_debug_line_t*)((const char*)hdr + hdr->line_off);
+    uint64_t lo = 0;
+    uint64_t hi = hdr->line_cnt;
+
+    while(lo < hi)
+    {
+        uint64_t mid = lo + (hi - lo) / 2;
+
+        if(line[mid].addr <= addr)
+        {
+            lo = mid + 1;
+        }
+        else
+        {
+            hi = mid;
+        }
+    }
+
+    return (lo == 0) ? NULL : &line[lo - 1];
+}
+
+#endif /* LA64ASM_DEBUGINFO_H */
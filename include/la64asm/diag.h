@@ -26,9 +26,22 @@
 #define LA64ASM_DIAG_H
 
 #include <la64asm/type.h>
+#include <stdio.h>
+#include <setjmp.h>
+
+typedef struct {
+    size_t line_num;                        /* line of the last error, 0 if it has none */
+    long msg_off;                           /* offset of its message in the capturing stream */
+} diag_record_t;
 
 void diag_note(compiler_token_t *ct, const char *msg, ...);
 void diag_warn(compiler_token_t *ct, const char *msg, ...);
 void diag_error(compiler_token_t *ct, const char *msg, ...);
 
+void diag_capture(FILE *fp, jmp_buf *env);
+void diag_record(diag_record_t *dr);
+FILE *diag_file(FILE *fp);
+void diag_perror(const char *path);
+void diag_exit(int status);
+
 #endif /* LA64ASM_DIAG_H */
@@ -0,0 +1,44 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2024 cr4zyengineer
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef LA64ASM_EXPR_H
+#define LA64ASM_EXPR_H
+
+#include <la64asm/type.h>
+#include <stdbool.h>
+
+typedef struct {
+    uint64_t value;                         /* constant part of the expression */
+    char *sym;                              /* label added to the value, NULL if none */
+    char *sub;                              /* label subtracted from the value, NULL if none */
+} expr_value_t;
+
+typedef void (*expr_symbol_fn)(const char *name, void *ctx);
+
+bool expr_is_expression(const char *str);
+void expr_eval(compiler_invocation_t *ci, compiler_token_t *ct, const char *scope, expr_value_t *ev);
+uint64_t expr_eval_constant(compiler_invocation_t *ci, compiler_token_t *ct);
+void expr_symbols(const char *str, expr_symbol_fn fn, void *ctx);
+
+#endif /* LA64ASM_EXPR_H */
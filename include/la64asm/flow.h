@@ -0,0 +1,59 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2024 cr4zyengineer
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef LA64ASM_FLOW_H
+#define LA64ASM_FLOW_H
+
+#include <la64/core.h>
+#include <la64asm/type.h>
+#include <stdbool.h>
+
+#define FLOW_LINE_NOT_FOUND                     UINT64_MAX
+
+typedef struct {
+    char *name;                             /* fully scoped name of the label */
+    uint64_t line;                          /* index of the line defining it */
+} flow_label_t;
+
+typedef struct {
+    flow_label_t *label;                    /* labels sorted by name */
+    uint64_t label_cnt;                     /* count of labels */
+    const char **scope;                     /* global label scope of every line */
+} flow_t;
+
+void flow_build(compiler_invocation_t *ci, flow_t *fl);
+void flow_free(flow_t *fl);
+void flow_release(void *fl);
+
+char *flow_label_name(flow_t *fl, uint64_t line, const char *str);
+uint64_t flow_label_line(flow_t *fl, const char *name);
+uint64_t flow_next_asm(compiler_invocation_t *ci, uint64_t line);
+
+int flow_line_opcode(compiler_line_t *cl);
+bool flow_line_is_branch(compiler_line_t *cl);
+bool flow_line_ends_block(compiler_line_t *cl);
+compiler_token_t *flow_line_target(compiler_line_t *cl);
+bool flow_token_is_label(compiler_token_t *ct);
+
+#endif /* LA64ASM_FLOW_H */
@@ -0,0 +1,91 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2024 cr4zyengineer
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef LA64ASM_INDEX_H
+#define LA64ASM_INDEX_H
+
+#include <la64asm/type.h>
+
+#define INDEX_SYMBOL_REF                        0b000
+#define INDEX_SYMBOL_LABEL                      0b001
+#define INDEX_SYMBOL_DATA                       0b010
+#define INDEX_SYMBOL_SECTION                    0b011
+#define INDEX_SYMBOL_DEFINE                     0b100
+#define INDEX_SYMBOL_MACRO                      0b101
+#define INDEX_SYMBOL_INCLUDE                    0b110
+
+#define INDEX_FLAG_DEF                          0b001
+#define INDEX_FLAG_BODY                         0b010
+#define INDEX_FLAG_HEAD                         0b100
+
+typedef struct {
+    const char *name;                       /* interned, local labels qualified, includes by canonical path */
+    uint32_t line;                          /* zero based line */
+    uint32_t col;                           /* zero based column the name starts at */
+    uint32_t len;                           /* length of the name as written */
+    uint8_t kind;                           /* INDEX_SYMBOL_* */
+    uint8_t flags;                          /* INDEX_FLAG_* */
+} index_symbol_t;
+
+typedef struct {
+    uint32_t line;                          /* zero based line */
+    uint32_t col;                           /* zero based column, 0 with len 0 for the whole line */
+    uint32_t len;                           /* length of what is wrong */
+    char *msg;                              /* message */
+} index_diag_t;
+
+typedef struct {
+    char *path;                             /* canonical path */
+    char *text;                             /* text as the editor has it, NULL if it comes from disk */
+    index_symbol_t *sym;                    /* symbols in line order */
+    uint64_t sym_cnt;                       /* count of symbols */
+    char *error;                            /* why the last tokenization failed, NULL if it did not */
+    uint32_t error_line;                    /* zero based line of the error */
+} index_doc_t;
+
+typedef struct {
+    const char *name;                       /* interned name, NULL if the slot is free */
+    uint64_t def_cnt;                       /* count of definitions across all documents */
+} index_def_t;
+
+typedef struct {
+    index_doc_t **doc;                      /* documents, allocated one by one so they never move */
+    uint64_t doc_cnt;                       /* count of documents */
+    index_def_t *def;                       /* definition counts by name, open addressed */
+    uint64_t def_size;                      /* count of slots, a power of two */
+    uint64_t def_used;                      /* count of used slots */
+} index_t;
+
+index_doc_t *index_doc(index_t *ix, const char *path);
+index_doc_t *index_add(index_t *ix, const char *path);
+void index_update(index_t *ix, index_doc_t *doc, const char *text, size_t len);
+bool index_reload(index_t *ix, index_doc_t *doc);
+void index_remove(index_t *ix, index_doc_t *doc);
+void index_workspace(index_t *ix, const char *root);
+index_symbol_t *index_symbol_at(index_doc_t *doc, uint32_t line, uint32_t col);
+uint64_t index_def_count(index_t *ix, const char *name);
+uint64_t index_diagnose(index_t *ix, index_doc_t *doc, index_diag_t **diag);
+void index_free(index_t *ix);
+
+#endif /* LA64ASM_INDEX_H */
@@ -0,0 +1,46 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2024 cr4zyengineer
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef COMPILER_INTERN_H
+#define COMPILER_INTERN_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/*
+ * every distinct identifier is stored once, so two interned strings are
+ * equal exactly when their pointers are, the table belongs to the thread
+ */
+const char *intern(const char *str);
+const char *intern_n(const char *str, size_t len);
+const char *intern_cat(const char *a, const char *b);
+const char *intern_find(const char *str);
+
+/* hash an interned string was stored under, it sits right in front of it */
+static inline uint64_t intern_hash(const char *str)
+{
+    return ((const uint64_t*)str)[-1];
+}
+
+#endif /* COMPILER_INTERN_H */
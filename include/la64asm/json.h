@@ -0,0 +1,58 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2024 cr4zyengineer
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef LA64ASM_JSON_H
+#define LA64ASM_JSON_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#define JSON_NULL                               0b000
+#define JSON_BOOL                               0b001
+#define JSON_NUMBER                             0b010
+#define JSON_STRING                             0b011
+#define JSON_ARRAY                              0b100
+#define JSON_OBJECT                             0b101
+
+typedef struct json json_t;
+
+struct json {
+    uint8_t type;                           /* JSON_* */
+    char *key;                              /* name of the member inside an object, NULL otherwise */
+    char *str;                              /* decoded string */
+    double num;                             /* number, 1 or 0 for booleans */
+    json_t *child;                          /* elements of an array, members of an object */
+    uint64_t child_cnt;                     /* count of elements or members */
+};
+
+json_t *json_parse(const char *str, size_t len);
+void json_free(json_t *js);
+json_t *json_get(json_t *js, const char *key);
+const char *json_string(json_t *js);
+double json_number(json_t *js, double def);
+void json_write(FILE *fp, json_t *js);
+void json_write_string(FILE *fp, const char *str);
+
+#endif /* LA64ASM_JSON_H */
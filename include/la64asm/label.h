@@ -33,6 +33,8 @@ void code_token_label(compiler_invocation_t *ci);
 void code_token_label_append(compiler_token_t *ct);
 void code_token_label_insert_start(compiler_invocation_t *ci);
 
+uint64_t label_add(compiler_invocation_t *ci, const char *name, uint64_t addr, compiler_token_t *ctlink);
+/* names passed to lookups have to be interned */
 uint64_t label_lookup(compiler_invocation_t *ci, const char *name);
 
 #endif /* COMPILER_LABEL_H */
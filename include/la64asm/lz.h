@@ -0,0 +1,87 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2024 cr4zyengineer
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef LA64ASM_LZ_H
+#define LA64ASM_LZ_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+/*
+ * compressed boot image written by la64asm --compress. the header is
+ * followed by the image cut into blocks of block_size bytes, the last one
+ * may be shorter. every block is a little endian uint32_t with its packed
+ * size, LA64_LZ_BLOCK_STORED set if it is stored as is, and the packed
+ * bytes. blocks never refer to each other, so each inflates on its own.
+ *
+ * a packed block is a list of sequences, each a token byte with the
+ * literal count in its high and the match length minus 4 in its low
+ * nibble, a nibble of 15 continues in bytes added up until one is below
+ * 255. the literals follow the token, then a little endian uint16_t
+ * offset back into what was inflated and the rest of the match length.
+ * the last sequence of a block ends behind its literals.
+ */
+
+#define LA64_LZ_MAGIC                           "LA64IMGZ"
+#define LA64_LZ_VERSION                         1
+#define LA64_LZ_BLOCK_SIZE                      0x10000
+#define LA64_LZ_BLOCK_STORED                    0x80000000u
+#define LA64_LZ_MIN_MATCH                       4
+
+#define LA64_LZ_MORE                            0
+#define LA64_LZ_DONE                            1
+#define LA64_LZ_ERROR                           -1
+
+typedef struct {
+    char magic[8];                          /* LA64_LZ_MAGIC, without a terminator */
+    uint32_t version;                       /* LA64_LZ_VERSION */
+    uint32_t block_size;                    /* bytes every block inflates to, except the last */
+    uint64_t entry;                         /* address of _start, the same as in the image header */
+    uint64_t bss_size;                      /* bytes the loader zeroes behind the image */
+    uint64_t size;                          /* size of the inflated image */
+} la64_lz_header_t;
+
+typedef void (*la64_lz_sink_fn)(const uint8_t *data, size_t len, void *ctx);
+
+typedef struct {
+    la64_lz_header_t hdr;                   /* header, valid once the first block is due */
+    uint8_t state;                          /* what the next bytes are */
+    uint32_t need;                          /* bytes the current part is long */
+    uint32_t got;                           /* bytes of the current part received */
+    uint32_t packed;                        /* packed size and flag of the current block */
+    uint64_t out;                           /* bytes inflated so far */
+    uint8_t *in;                            /* current block, if it arrived in pieces */
+    uint8_t *buf;                           /* inflated block */
+} la64_lz_stream_t;
+
+size_t la64_lz_bound(size_t len);
+size_t la64_lz_compress_block(const uint8_t *src, size_t len, uint8_t *dst, size_t cap);
+bool la64_lz_decompress_block(const uint8_t *src, size_t len, uint8_t *dst, size_t dst_len);
+
+void la64_lz_stream_init(la64_lz_stream_t *ls);
+int la64_lz_stream_feed(la64_lz_stream_t *ls, const void *data, size_t len, la64_lz_sink_fn sink, void *ctx);
+void la64_lz_stream_free(la64_lz_stream_t *ls);
+
+#endif /* LA64ASM_LZ_H */
@@ -0,0 +1,133 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2024 cr4zyengineer
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef LA64ASM_NUMBER_H
+#define LA64ASM_NUMBER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+/*
+ * fast path for the plain decimal and hexadecimal literals that make up
+ * large data tables, anything else (chars, strings, labels, other bases)
+ * is left to the generic parser by returning false
+ */
+
+static inline bool number_is_digits8(uint64_t chunk)
+{
+    /* every byte is in '0'..'9' if its high nibble is 3 and adding 6 does not carry into it */
+    return ((chunk & 0xF0F0F0F0F0F0F0F0ULL) |
+            (((chunk + 0x0606060606060606ULL) & 0xF0F0F0F0F0F0F0F0ULL) >> 4)) == 0x3333333333333333ULL;
+}
+
+static inline uint64_t number_parse_digits8(uint64_t chunk)
+{
+    /* combining neighbouring digits pairwise, then the pairs, then the quads */
+    chunk -= 0x3030303030303030ULL;
+    chunk = (chunk * 10) + (chunk >> 8);
+    return (((chunk & 0x000000FF000000FFULL) * (100 + (1000000ULL << 32))) +
+            (((chunk >> 16) & 0x000000FF000000FFULL) * (1 + (10000ULL << 32)))) >> 32;
+}
+
+static inline int number_hex_digit(char c)
+{
+    if(c >= '0' && c <= '9')
+    {
+        return c - '0';
+    }
+
+    c |= 0x20;
+    return (c >= 'a' && c <= 'f') ? c - 'a' + 10 : -1;
+}
+
+static inline bool number_parse(const char *str,
+                                uint64_t *value)
+{
+    uint64_t res = 0;
+
+    if(str[0] == '0' && (str[1] == 'x' || str[1] == 'X'))
+    {
+        str += 2;
+
+        if(*str == '\0')
+        {
+            return false;
+        }
+
+        for(; *str != '\0'; str++)
+        {
+            int digit = number_hex_digit(*str);
+
+            if(digit < 0 || (res >> 60) != 0)
+            {
+                return false;
+            }
+
+            res = (res << 4) | digit;
+        }
+
+        *value = res;
+        return true;
+    }
+
+    size_t len = strlen(str);
+
+    /* a leading zero might mean another base to the generic parser */
+    if(len == 0 || (len > 1 && str[0] == '0'))
+    {
+        return false;
+    }
+
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    /* eight digits at a time while there are that many left */
+    for(; len >= 8; str += 8, len -= 8)
+    {
+        uint64_t chunk;
+        memcpy(&chunk, str, sizeof(chunk));
+
+        if(!number_is_digits8(chunk) ||
+           __builtin_mul_overflow(res, 100000000ULL, &res) ||
+           __builtin_add_overflow(res, number_parse_digits8(chunk), &res))
+        {
+            return false;
+        }
+    }
+#endif
+
+    for(; len > 0; str++, len--)
+    {
+        if(*str < '0' || *str > '9' ||
+           __builtin_mul_overflow(res, 10, &res) ||
+           __builtin_add_overflow(res, (uint64_t)(*str - '0'), &res))
+        {
+            return false;
+        }
+    }
+
+    *value = res;
+    return true;
+}
+
+#endif /* LA64ASM_NUMBER_H */
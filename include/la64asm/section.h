@@ -27,7 +27,11 @@
 
 #include <la64asm/type.h>
 
+uint8_t code_section_kind(const char *name);
+void code_token_section_assign(compiler_invocation_t *ci);
 void code_token_section(compiler_invocation_t *ci);
 void code_remove_sections(compiler_invocation_t *ci);
+void code_token_section_place_bss(compiler_invocation_t *ci);
+void code_token_section_insert_bss(compiler_invocation_t *ci);
 
 #endif /* COMPILER_SECTION_H */
@@ -0,0 +1,120 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2024 cr4zyengineer
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef LA64ASM_TEMPLATE_H
+#define LA64ASM_TEMPLATE_H
+
+#include <la64/core.h>
+#include <stdint.h>
+#include <string.h>
+
+/*
+ * encoding templates for instructions with up to two operands, the
+ * codings of a shape never change, so they are packed ahead of time
+ * and only opcode and values are or'ed in, the bit order is the one
+ * of the little endian bitwalker, lowest bit first
+ */
+typedef unsigned __int128 la64_template_bits_t;
+
+typedef struct {
+    uint8_t bits;                           /* length of the encoding in bits, 0 if it does not fit */
+    uint8_t shift[2];                       /* bit offset of each value */
+    la64_template_bits_t codings;           /* codings and the end marker at their offsets */
+} la64_template_t;
+
+#define LA64_TEMPLATE_REG                       0
+#define LA64_TEMPLATE_IMM8                      1
+#define LA64_TEMPLATE_IMM16                     2
+#define LA64_TEMPLATE_IMM32                     3
+#define LA64_TEMPLATE_IMM64                     4
+
+#define LA64_TEMPLATE_CODING(c)                 ((c) == LA64_TEMPLATE_REG ? LA64_PARAMETER_CODING_REG : \
+                                                 (c) == LA64_TEMPLATE_IMM8 ? LA64_PARAMETER_CODING_IMM8 : \
+                                                 (c) == LA64_TEMPLATE_IMM16 ? LA64_PARAMETER_CODING_IMM16 : \
+                                                 (c) == LA64_TEMPLATE_IMM32 ? LA64_PARAMETER_CODING_IMM32 : \
+                                                 LA64_PARAMETER_CODING_IMM64)
+#define LA64_TEMPLATE_WIDTH(c)                  ((c) == LA64_TEMPLATE_REG ? 5 : 8 << ((c) - 1))
+
+/* opcode, the end marker */
+#define LA64_TEMPLATE_0()                       { .bits = 11, \
+                                                  .codings = (la64_template_bits_t)LA64_PARAMETER_CODING_INSTR_END << 8 }
+
+/* opcode, coding, value, the end marker */
+#define LA64_TEMPLATE_1(a)                      { .bits = 14 + LA64_TEMPLATE_WIDTH(a), \
+                                                  .shift = { 11, 0 }, \
+                                                  .codings = ((la64_template_bits_t)LA64_TEMPLATE_CODING(a) << 8) | \
+                                                             ((la64_template_bits_t)LA64_PARAMETER_CODING_INSTR_END << (11 + LA64_TEMPLATE_WIDTH(a))) }
+
+/* opcode, coding, value, coding, value, the end marker, if it fits */
+#define LA64_TEMPLATE_2(a, b)                   { .bits = (17 + LA64_TEMPLATE_WIDTH(a) + LA64_TEMPLATE_WIDTH(b) <= 128) ? 17 + LA64_TEMPLATE_WIDTH(a) + LA64_TEMPLATE_WIDTH(b) : 0, \
+                                                  .shift = { 11, 14 + LA64_TEMPLATE_WIDTH(a) }, \
+                                                  .codings = (17 + LA64_TEMPLATE_WIDTH(a) + LA64_TEMPLATE_WIDTH(b) > 128) ? 0 : \
+                                                             ((la64_template_bits_t)LA64_TEMPLATE_CODING(a) << 8) | \
+                                                             ((la64_template_bits_t)LA64_TEMPLATE_CODING(b) << (11 + LA64_TEMPLATE_WIDTH(a))) | \
+                                                             ((la64_template_bits_t)LA64_PARAMETER_CODING_INSTR_END << ((14 + LA64_TEMPLATE_WIDTH(a) + LA64_TEMPLATE_WIDTH(b)) & 127)) }
+
+#define LA64_TEMPLATE_ROW(a)                    LA64_TEMPLATE_2(a, LA64_TEMPLATE_REG), \
+                                                LA64_TEMPLATE_2(a, LA64_TEMPLATE_IMM8), \
+                                                LA64_TEMPLATE_2(a, LA64_TEMPLATE_IMM16), \
+                                                LA64_TEMPLATE_2(a, LA64_TEMPLATE_IMM32), \
+                                                LA64_TEMPLATE_2(a, LA64_TEMPLATE_IMM64)
+
+/* no operands, then one per class, then every pair of classes */
+static const la64_template_t la64_template[] = {
+    LA64_TEMPLATE_0(),
+    LA64_TEMPLATE_1(LA64_TEMPLATE_REG),
+    LA64_TEMPLATE_1(LA64_TEMPLATE_IMM8),
+    LA64_TEMPLATE_1(LA64_TEMPLATE_IMM16),
+    LA64_TEMPLATE_1(LA64_TEMPLATE_IMM32),
+    LA64_TEMPLATE_1(LA64_TEMPLATE_IMM64),
+    LA64_TEMPLATE_ROW(LA64_TEMPLATE_REG),
+    LA64_TEMPLATE_ROW(LA64_TEMPLATE_IMM8),
+    LA64_TEMPLATE_ROW(LA64_TEMPLATE_IMM16),
+    LA64_TEMPLATE_ROW(LA64_TEMPLATE_IMM32),
+    LA64_TEMPLATE_ROW(LA64_TEMPLATE_IMM64),
+};
+
+/* smallest immediate coding holding the value, like the bitwalker path picks it */
+static inline uint8_t la64_template_imm_class(uint64_t value)
+{
+    return (value <= 0xFF) ? LA64_TEMPLATE_IMM8 :
+           (value <= 0xFFFF) ? LA64_TEMPLATE_IMM16 :
+           (value <= 0xFFFFFFFF) ? LA64_TEMPLATE_IMM32 : LA64_TEMPLATE_IMM64;
+}
+
+/* storing all sixteen bytes, the caller makes sure there is room */
+static inline void la64_template_store(uint8_t *out,
+                                       la64_template_bits_t bits)
+{
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    memcpy(out, &bits, sizeof(bits));
+#else
+    for(size_t i = 0; i < sizeof(bits); i++)
+    {
+        out[i] = (uint8_t)(bits >> (i * 8));
+    }
+#endif
+}
+
+#endif /* LA64ASM_TEMPLATE_H */
@@ -27,6 +27,7 @@
 
 #include <stdlib.h>
 #include <stdint.h>
+#include <stdbool.h>
 
 #include <lautils/bitwalker.h>
 
@@ -37,6 +38,38 @@
 #define COMPILER_LINE_TYPE_SECTION              0b0100
 #define COMPILER_LINE_TYPE_SECTION_DATA         0b0101
 #define COMPILER_LINE_TYPE_MACRODEF             0b0110
+#define COMPILER_LINE_TYPE_EXPORT               0b0111
+#define COMPILER_LINE_TYPE_MACROBEGIN           0b1000
+#define COMPILER_LINE_TYPE_MACROEND             0b1001
+#define COMPILER_LINE_TYPE_REPT                 0b1010
+#define COMPILER_LINE_TYPE_ENDR                 0b1011
+#define COMPILER_LINE_TYPE_INCLUDE              0b1100
+
+#define COMPILER_IMAGE_HEADER_ENTRY             0x00    /* address of _start */
+#define COMPILER_IMAGE_HEADER_BSS               0x08    /* bytes the loader zeroes behind the image */
+#define COMPILER_IMAGE_HEADER_SIZE              0x10
+
+#define COMPILER_SECTION_KIND_CODE              0b00
+#define COMPILER_SECTION_KIND_DATA              0b01
+#define COMPILER_SECTION_KIND_BSS               0b10
+
+#define COMPILER_SECTION_NONE                   UINT64_MAX
+
+#define COMPILER_IR_NONE                        UINT64_MAX
+
+#define COMPILER_IR_OPERAND_REG                 0b00
+#define COMPILER_IR_OPERAND_IMM                 0b01
+#define COMPILER_IR_OPERAND_SYM                 0b10
+
+#define COMPILER_FLAG_NONE                      0b0000
+#define COMPILER_FLAG_REPORT                    0b0001
+#define COMPILER_FLAG_STRENGTH_REDUCE           0b0010
+#define COMPILER_FLAG_BRANCH_OPT                0b0100
+#define COMPILER_FLAG_TAIL_CALL                 0b1000
+#define COMPILER_FLAG_DEAD_STRIP                0b10000
+#define COMPILER_FLAG_MERGE_CONSTANTS           0b100000
+#define COMPILER_FLAG_VERIFY_ENCODING           0b1000000
+#define COMPILER_FLAG_COMPRESS                  0b10000000
 
 typedef unsigned char compiler_line_type_t;
 typedef struct compiler_invocation compiler_invocation_t;
@@ -55,39 +88,143 @@ typedef struct compiler_line {
     uint64_t token_cnt;                     /* count of subtokens */
     size_t line_num;                        /* line number in file */   
     size_t file_idx;                        /* index of file in compiler invocation */
+    uint64_t addr;                          /* address the line was encoded at, 0 if it produced no code */
+    uint64_t section;                       /* index of the section the line belongs to */
+    uint64_t instr;                         /* index of the instruction in the IR, COMPILER_IR_NONE if none */
     compiler_invocation_t *ci;              /* pointer back to compiler invocation */
 } compiler_line_t;
 
+typedef struct {
+    uint64_t flags;                         /* COMPILER_FLAG_* bits selected on the command line */
+    const char *output;                     /* path of the boot image */
+    const char *depfile;                    /* path of the make dependency file, NULL if none */
+    uint64_t align_functions;               /* alignment of global labels in code, 0 if none */
+    const char *map;                        /* path of the symbol map, NULL if none */
+    const char *debuginfo;                  /* path of the binary symbol and line table, NULL if none */
+    const char *profile;                    /* path of the profile to lay out functions by, NULL if none */
+    const char *instrument;                 /* path of the counter to line table, NULL if not instrumenting */
+    const char *layout;                     /* path of the section layout, NULL if none */
+} compiler_options_t;
+
+typedef struct {
+    char *real;                             /* canonical path of the file */
+    char *code;                             /* contents as last read, NULL until read */
+    size_t len;                             /* length of the contents */
+    compiler_line_t *line;                  /* lines as tokenized, before typing, NULL until tokenized */
+    uint64_t line_cnt;                      /* count of lines */
+    bool stale;                             /* changed since it was read */
+    bool used;                              /* read by the last invocation */
+} compiler_cache_file_t;
+
+typedef struct {
+    compiler_cache_file_t **file;           /* cached files, allocated one by one so they never move */
+    uint64_t file_cnt;                      /* count of cached files */
+} compiler_cache_t;
+
 typedef struct {
     char *path;
     char *code;
     size_t len;
+    compiler_cache_file_t *cache;           /* cache entry the file was read through, NULL if none */
 } compiler_file_t;
 
 typedef struct {
-    char *name;                             /* name of resolved label */
+    char *path;                             /* path as it was opened */
+    char *real;                             /* canonical path to detect files read twice */
+} compiler_dep_t;
+
+typedef struct {
+    char *name;                             /* name as written behind "section" */
+    uint8_t kind;                           /* COMPILER_SECTION_KIND_* */
+    uint64_t base;                          /* address the layout puts the section at, 0 if any */
+    uint64_t align;                         /* alignment the layout asks for, 0 if none */
+    uint64_t order;                         /* position in the layout, UINT64_MAX if not listed */
+} compiler_section_t;
+
+typedef struct {
+    const char *name;                       /* interned name of resolved label */
     uint64_t addr;                          /* address of resolved label */
     compiler_token_t *ctlink;               /* link to the originator of the label */
 } compiler_label_t;
 
 typedef struct {
-    char *name;                             /* unknown label looking for address */
+    char *key;                              /* arguments of the expansion separated by '\x1f' */
+    compiler_line_t *line;                  /* fully expanded lines */
+    uint64_t line_cnt;                      /* count of expanded lines */
+} compiler_macro_expansion_t;
+
+typedef struct {
+    const char *name;                       /* interned name of the macro */
+    char *value;                            /* replacement of a %define% macro */
+    char **param;                           /* parameter names of a %macro% macro */
+    uint64_t param_cnt;                     /* count of parameters */
+    compiler_line_t *body;                  /* body lines of a %macro% macro */
+    uint64_t body_cnt;                      /* count of body lines */
+    compiler_macro_expansion_t *memo;       /* expansions already done for a argument set */
+    uint64_t memo_cnt;                      /* count of memoized expansions */
+    bool unique;                            /* expansions use \@, so none is reused */
+} compiler_macro_t;
+
+typedef struct {
+    const char *name;                       /* interned unknown label looking for address */
+    const char *sub;                        /* interned label whose address is subtracted, NULL if none */
+    uint64_t addend;                        /* constant added to the address */
+    uint8_t bits;                           /* width of the entry written, 0 if 64bit */
     bitwalker_t bw;                         /* bitwalker state of when it was looked for (always 64bit skipped) */
     compiler_token_t *ctlink;               /* link to the originator of the entry */
 } reloc_table_entry;
 
+typedef struct {
+    uint64_t *line;                         /* line each instruction was lowered from */
+    uint8_t *opcode;                        /* opcode of each instruction */
+    uint8_t *operand_cnt;                   /* count of operands of each instruction */
+    uint64_t *operand;                      /* index of the first operand of each instruction */
+    uint64_t instr_cnt;                     /* count of instructions */
+    uint8_t *kind;                          /* COMPILER_IR_OPERAND_* of each operand */
+    uint64_t *value;                        /* register, immediate or addend of each operand */
+    const char **sym;                       /* interned label of symbol operands, NULL otherwise */
+    const char **sub;                       /* interned label subtracted from the symbol, NULL if none */
+    uint64_t value_cnt;                     /* count of operands */
+} compiler_ir_t;
+
+typedef void (*compiler_release_t)(void *ptr);
+
+typedef struct {
+    void *ptr;                              /* scratch held by a pass */
+    compiler_release_t release;             /* lets go of it */
+} compiler_resource_t;
+
 typedef struct compiler_invocation {
+    const compiler_options_t *opt;          /* options of this invocation */
+    compiler_cache_t *cache;                /* files kept from earlier invocations, NULL if none */
     compiler_file_t *file;                  /* code files */
     size_t file_cnt;                        /* count of files */
+    compiler_dep_t *dep;                    /* every file read, for dependency output */
+    uint64_t dep_cnt;                       /* count of dependencies */
     compiler_line_t *line;                  /* token array */
     uint64_t line_cnt;                      /* count of tokens */
-    char *label_scope;                      /* current resolved label scope */
+    compiler_macro_t *macro;                /* macro array */
+    uint64_t macro_cnt;                     /* count of macros */
+    uint64_t macro_unique;                  /* number the next \@ expands to */
+    compiler_section_t *section;            /* sections in order of appearance */
+    uint64_t section_cnt;                   /* count of sections */
+    const char *label_scope;                /* current resolved label scope, interned */
     compiler_label_t *label;                /* label array */
     uint64_t label_cnt;                     /* count of labels */
-    reloc_table_entry rtlb[0xFFFFFF];       /* relocation table */
+    uint64_t *label_hash;                   /* label index + 1 by interned name, open addressed */
+    uint64_t label_hash_size;               /* count of hash slots, a power of two */
+    compiler_ir_t ir;                       /* instructions in their compact form */
+    reloc_table_entry *rtlb;                /* relocation table */
     uint64_t rtlb_cnt;                      /* count of relocation table entries */
+    uint64_t rtlb_cap;                      /* capacity of the relocation table */
     uint8_t image[0xFFFFFF];                /* replace with better technique that is more incremental */
     uint64_t image_addr;                    /* current address */
+    uint64_t bss_size;                      /* size of .bss, which is not part of the image */
+    uint64_t bss_align;                     /* largest alignment requested in .bss */
+    uint64_t *bss_label;                    /* indices of labels relative to .bss */
+    uint64_t bss_label_cnt;                 /* count of .bss labels */
+    compiler_resource_t *res;               /* scratch of running passes, released if one fails */
+    uint64_t res_cnt;                       /* count of held resources */
 } compiler_invocation_t;
 
 #endif /* COMPILER_TYPE_H */
@@ -0,0 +1,242 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2024 cr4zyengineer
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <la64asm/batch.h>
+#include <la64asm/compile.h>
+#include <la64asm/diag.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <setjmp.h>
+#include <pthread.h>
+#include <unistd.h>
+
+typedef struct {
+    char *output;                           /* path of the boot image */
+    char **input;                           /* assembly files making up the program */
+    int input_cnt;                          /* count of assembly files */
+} batch_job_t;
+
+typedef struct {
+    const compiler_options_t *opt;          /* options shared by every job */
+    bool md;                                /* write a dependency file next to every output */
+    batch_job_t *job;                       /* jobs in manifest order */
+    uint64_t job_cnt;                       /* count of jobs */
+    uint64_t next;                          /* next job to hand out */
+    uint64_t failed;                        /* count of jobs that did not produce a image */
+    pthread_mutex_t lock;                   /* guards next, failed and the output */
+} batch_t;
+
+static void batch_load(batch_t *b,
+                       const char *manifest)
+{
+    FILE *fp = fopen(manifest, "r");
+
+    if(fp == NULL)
+    {
+        perror(manifest);
+        exit(EXIT_FAILURE);
+    }
+
+    /* "output: input..." per line, like a make rule */
+    char *line = NULL;
+    size_t cap = 0;
+    uint64_t num = 0;
+
+    while(getline(&line, &cap, fp) > 0)
+    {
+        num++;
+        line[strcspn(line, "#\r\n")] = '\0';
+
+        char *colon = strchr(line, ':');
+        char *save = NULL;
+        char *output = (colon == NULL) ? NULL : strtok_r(line, " \t:", &save);
+
+        if(output == NULL || output > colon)
+        {
+            if(strtok_r(line, " \t", &save) == NULL)
+            {
+                continue;
+            }
+
+            fprintf(stderr, "%s:%lu: expected \"output: input...\"\n", manifest, num);
+            exit(EXIT_FAILURE);
+        }
+
+        b->job = realloc(b->job, (b->job_cnt + 1) * sizeof(batch_job_t));
+        batch_job_t *job = &(b->job[b->job_cnt++]);
+        job->output = strdup(output);
+        job->input = NULL;
+        job->input_cnt = 0;
+
+        for(char *tok = strtok_r(colon + 1, " \t", &save); tok != NULL; tok = strtok_r(NULL, " \t", &save))
+        {
+            job->input = realloc(job->input, (job->input_cnt + 1) * sizeof(char*));
+            job->input[job->input_cnt++] = strdup(tok);
+        }
+
+        if(job->input_cnt == 0)
+        {
+            fprintf(stderr, "%s:%lu: \"%s\" has no inputs\n", manifest, num, output);
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    free(line);
+    fclose(fp);
+}
+
+static void batch_run(batch_t *b,
+                      batch_job_t *job,
+                      compiler_invocation_t *ci)
+{
+    /* every job gets its own output and a cleared invocation, the rest is shared */
+    compiler_options_t opt = *(b->opt);
+    char *depfile = NULL;
+
+    opt.output = job->output;
+
+    if(b->md)
+    {
+        asprintf(&depfile, "%s.d", job->output);
+        opt.depfile = depfile;
+    }
+
+    /* diagnostics are collected and errors unwind back here */
+    char *diag = NULL;
+    size_t diag_len = 0;
+    FILE *fp = open_memstream(&diag, &diag_len);
+    jmp_buf env;
+
+    compiler_invocation_reset(ci, &opt);
+    int status = setjmp(env);
+
+    if(status == 0)
+    {
+        diag_capture(fp, &env);
+        compile_invocation(ci, (const char**)job->input, job->input_cnt);
+    }
+
+    diag_capture(NULL, NULL);
+    fclose(fp);
+
+    /* reporting in one piece, so the diagnostics of jobs never interleave */
+    pthread_mutex_lock(&(b->lock));
+
+    if(diag_len > 0 || status != 0)
+    {
+        printf("%s: %s\n", job->output, (status == 0) ? "done" : "failed");
+        fwrite(diag, 1, diag_len, stdout);
+        fflush(stdout);
+    }
+
+    b->failed += (status != 0);
+    pthread_mutex_unlock(&(b->lock));
+
+    free(diag);
+    free(depfile);
+}
+
+static void *batch_worker(void *arg)
+{
+    batch_t *b = arg;
+
+    /* one invocation per worker, its image is far too big to allocate per job */
+    compiler_invocation_t *ci = compiler_invocation_alloc(b->opt);
+
+    while(1)
+    {
+        /* taking the next job, the cheap ones finish early and take more */
+        pthread_mutex_lock(&(b->lock));
+        uint64_t idx = b->next++;
+        pthread_mutex_unlock(&(b->lock));
+
+        if(idx >= b->job_cnt)
+        {
+            break;
+        }
+
+        batch_run(b, &(b->job[idx]), ci);
+    }
+
+    compiler_invocation_dealloc(ci);
+    return NULL;
+}
+
+int compile_batch(const char *manifest,
+                  unsigned long jobs,
+                  bool md,
+                  const compiler_options_t *opt)
+{
+    batch_t b = { .opt = opt, .md = md };
+    pthread_mutex_init(&(b.lock), NULL);
+    batch_load(&b, manifest);
+
+    /* one worker per cpu unless told otherwise, never more than there are jobs */
+    if(jobs == 0)
+    {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        jobs = (cpus > 0) ? cpus : 1;
+    }
+
+    jobs = (jobs > b.job_cnt) ? b.job_cnt : jobs;
+
+    pthread_t *worker = calloc(jobs, sizeof(pthread_t));
+    for(unsigned long i = 0; i < jobs; i++)
+    {
+        if(pthread_create(&(worker[i]), NULL, batch_worker, &b) != 0)
+        {
+            perror("pthread_create");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    for(unsigned long i = 0; i < jobs; i++)
+    {
+        pthread_join(worker[i], NULL);
+    }
+
+    if(b.failed > 0)
+    {
+        fprintf(stderr, "%lu of %lu jobs failed\n", b.failed, b.job_cnt);
+    }
+
+    /* releasing the manifest */
+    for(uint64_t i = 0; i < b.job_cnt; i++)
+    {
+        for(int a = 0; a < b.job[i].input_cnt; a++)
+        {
+            free(b.job[i].input[a]);
+        }
+
+        free(b.job[i].input);
+        free(b.job[i].output);
+    }
+
+    free(b.job);
+    free(worker);
+    pthread_mutex_destroy(&(b.lock));
+
+    return (b.failed > 0) ? EXIT_FAILURE : EXIT_SUCCESS;
+}
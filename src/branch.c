@@ -0,0 +1,221 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2024 cr4zyengineer
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <la64asm/branch.h>
+#include <la64asm/flow.h>
+#include <la64asm/diag.h>
+#include <la64asm/code.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+
+#define BRANCH_THREAD_MAX_HOPS                  64
+
+static void branch_tail_calls(compiler_invocation_t *ci)
+{
+    for(uint64_t i = 0; i < ci->line_cnt; i++)
+    {
+        compiler_line_t *cl = &(ci->line[i]);
+
+        if(flow_line_opcode(cl) != LA64_OPCODE_BL ||
+           cl->token_cnt != 2 ||
+           flow_line_target(cl) == NULL)
+        {
+            continue;
+        }
+
+        /* the call must be directly followed by a return nobody else branches to */
+        uint64_t next = flow_next_asm(ci, i);
+        if(next == FLOW_LINE_NOT_FOUND ||
+           flow_line_opcode(&(ci->line[next])) != LA64_OPCODE_RET)
+        {
+            continue;
+        }
+
+        bool labeled = false;
+        for(uint64_t a = i + 1; a < next; a++)
+        {
+            if(ci->line[a].type == COMPILER_LINE_TYPE_GLOBAL_LABEL ||
+               ci->line[a].type == COMPILER_LINE_TYPE_LOCAL_LABEL)
+            {
+                labeled = true;
+                break;
+            }
+        }
+
+        if(labeled)
+        {
+            continue;
+        }
+
+        if(ci->opt->flags & COMPILER_FLAG_REPORT)
+        {
+            diag_note(&(cl->token[0]), "turned \"bl %s\" followed by \"ret\" into a tail call\n", cl->token[1].str);
+        }
+
+        /* bl pushes the return address, so jumping lets the callee return to our caller */
+        free(cl->token[0].str);
+        cl->token[0].str = strdup("jmp");
+        ci->line[next].type = COMPILER_LINE_TYPE_NONE;
+    }
+}
+
+static bool branch_thread(compiler_invocation_t *ci,
+                          flow_t *fl)
+{
+    bool changed = false;
+
+    for(uint64_t i = 0; i < ci->line_cnt; i++)
+    {
+        compiler_line_t *cl = &(ci->line[i]);
+        compiler_token_t *ct = NULL;
+
+        if(!flow_line_is_branch(cl) ||
+           (ct = flow_line_target(cl)) == NULL)
+        {
+            continue;
+        }
+
+        /* following the chain of unconditional jumps the target starts with */
+        char *name = flow_label_name(fl, i, ct->str);
+        uint64_t target = flow_label_line(fl, name);
+        uint64_t hops = 0;
+
+        while(target != FLOW_LINE_NOT_FOUND && hops < BRANCH_THREAD_MAX_HOPS)
+        {
+            uint64_t next = flow_next_asm(ci, target);
+            compiler_token_t *nt = NULL;
+
+            if(next == FLOW_LINE_NOT_FOUND ||
+               next == i ||
+               flow_line_opcode(&(ci->line[next])) != LA64_OPCODE_JMP ||
+               (nt = flow_line_target(&(ci->line[next]))) == NULL)
+            {
+                break;
+            }
+
+            char *nname = flow_label_name(fl, next, nt->str);
+            uint64_t ntarget = flow_label_line(fl, nname);
+
+            if(ntarget == FLOW_LINE_NOT_FOUND || ntarget == target)
+            {
+                free(nname);
+                break;
+            }
+
+            free(name);
+            name = nname;
+            target = ntarget;
+            hops++;
+        }
+
+        if(hops > 0)
+        {
+            if(ci->opt->flags & COMPILER_FLAG_REPORT)
+            {
+                diag_note(ct, "threaded branch to \"%s\" through to \"%s\"\n", ct->str, name);
+            }
+
+            /* the scoped name is valid from every scope */
+            free(ct->str);
+            ct->str = name;
+            changed = true;
+        }
+        else
+        {
+            free(name);
+        }
+    }
+
+    return changed;
+}
+
+static bool branch_remove_next(compiler_invocation_t *ci,
+                               flow_t *fl)
+{
+    bool changed = false;
+
+    for(uint64_t i = 0; i < ci->line_cnt; i++)
+    {
+        compiler_line_t *cl = &(ci->line[i]);
+        compiler_token_t *ct = NULL;
+
+        if(!flow_line_is_branch(cl) ||
+           (ct = flow_line_target(cl)) == NULL)
+        {
+            continue;
+        }
+
+        char *name = flow_label_name(fl, i, ct->str);
+        uint64_t target = flow_label_line(fl, name);
+        free(name);
+
+        /* no instruction between the branch and its target means it is a no-op either way */
+        uint64_t next = flow_next_asm(ci, i);
+        if(target == FLOW_LINE_NOT_FOUND ||
+           target < i ||
+           ci->line[target].section != cl->section ||
+           (next != FLOW_LINE_NOT_FOUND && next < target))
+        {
+            continue;
+        }
+
+        if(ci->opt->flags & COMPILER_FLAG_REPORT)
+        {
+            diag_note(&(cl->token[0]), "removed \"%s %s\" to the next instruction\n", cl->token[0].str, ct->str);
+        }
+
+        cl->type = COMPILER_LINE_TYPE_NONE;
+        changed = true;
+    }
+
+    return changed;
+}
+
+void code_token_branch_optimize(compiler_invocation_t *ci)
+{
+    /* tail calls are a call convention matter, so they are enabled separately */
+    if(ci->opt->flags & COMPILER_FLAG_TAIL_CALL)
+    {
+        branch_tail_calls(ci);
+    }
+
+    if(!(ci->opt->flags & COMPILER_FLAG_BRANCH_OPT))
+    {
+        return;
+    }
+
+    /* building the label map once, deleting lines does not move labels, it goes with the invocation if anything fails */
+    flow_t *fl = calloc(1, sizeof(flow_t));
+    code_resource_hold(ci, fl, flow_release);
+    flow_build(ci, fl);
+
+    branch_thread(ci, fl);
+
+    /* removing a branch can turn the one before it into a branch to the next instruction */
+    while(branch_remove_next(ci, fl));
+
+    code_resource_drop(ci, fl);
+}
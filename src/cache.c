@@ -0,0 +1,149 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2024 cr4zyengineer
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <la64asm/cache.h>
+#include <la64asm/code.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+compiler_cache_file_t *cache_file(compiler_cache_t *cc,
+                                  const char *real)
+{
+    for(uint64_t i = 0; i < cc->file_cnt; i++)
+    {
+        if(strcmp(cc->file[i]->real, real) == 0)
+        {
+            cc->file[i]->used = true;
+            return cc->file[i];
+        }
+    }
+
+    /* first time the file is seen, it is read like any other */
+    compiler_cache_file_t *cf = calloc(1, sizeof(compiler_cache_file_t));
+    cf->real = strdup(real);
+    cf->used = true;
+
+    cc->file = realloc(cc->file, (cc->file_cnt + 1) * sizeof(compiler_cache_file_t*));
+    cc->file[cc->file_cnt++] = cf;
+
+    return cf;
+}
+
+static void cache_file_drop_lines(compiler_cache_file_t *cf)
+{
+    for(uint64_t i = 0; i < cf->line_cnt; i++)
+    {
+        code_line_free(&(cf->line[i]));
+    }
+
+    free(cf->line);
+    cf->line = NULL;
+    cf->line_cnt = 0;
+}
+
+void cache_file_store(compiler_cache_file_t *cf,
+                      const char *code,
+                      size_t len)
+{
+    /* new contents, the old lines no longer match them */
+    cache_file_drop_lines(cf);
+    free(cf->code);
+
+    cf->code = malloc(len + 2);
+    memcpy(cf->code, code, len + 2);
+    cf->len = len;
+    cf->stale = false;
+}
+
+void cache_file_store_lines(compiler_cache_file_t *cf,
+                            compiler_line_t *line,
+                            uint64_t line_cnt)
+{
+    /* the invocation rewrites its lines in place, the cache keeps a copy of its own */
+    cache_file_drop_lines(cf);
+
+    cf->line = calloc(line_cnt, sizeof(compiler_line_t));
+    cf->line_cnt = line_cnt;
+
+    for(uint64_t i = 0; i < line_cnt; i++)
+    {
+        code_line_copy(&(cf->line[i]), &(line[i]));
+        cf->line[i].ci = NULL;
+    }
+}
+
+bool cache_mark_stale(compiler_cache_t *cc,
+                      const char *real)
+{
+    for(uint64_t i = 0; i < cc->file_cnt; i++)
+    {
+        if(strcmp(cc->file[i]->real, real) == 0)
+        {
+            cc->file[i]->stale = true;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static void cache_file_free(compiler_cache_file_t *cf)
+{
+    cache_file_drop_lines(cf);
+    free(cf->code);
+    free(cf->real);
+    free(cf);
+}
+
+void cache_prune(compiler_cache_t *cc)
+{
+    /* files no longer included by anything are forgotten, the rest has to be used again to stay */
+    uint64_t kept = 0;
+    for(uint64_t i = 0; i < cc->file_cnt; i++)
+    {
+        if(!cc->file[i]->used)
+        {
+            cache_file_free(cc->file[i]);
+            continue;
+        }
+
+        cc->file[i]->used = false;
+        cc->file[kept++] = cc->file[i];
+    }
+
+    cc->file_cnt = kept;
+}
+
+void cache_free(compiler_cache_t *cc)
+{
+    for(uint64_t i = 0; i < cc->file_cnt; i++)
+    {
+        cache_file_free(cc->file[i]);
+    }
+
+    free(cc->file);
+    cc->file = NULL;
+    cc->file_cnt = 0;
+}
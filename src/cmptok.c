@@ -77,6 +77,7 @@ const char *cmptok(const char *token)
 
     /* perform copy */
     unsigned short a = 0;
+    unsigned short paren = 0;
     unsigned char token_mode = CMPTOK_TOKEN_MODE_NONE;
     while(a < 512)
     {
@@ -88,11 +89,27 @@ const char *cmptok(const char *token)
                 {
                     /* handling what shall be skipped and not tokenized */
                     case ';':
+                        cmptok_skip_triggers();
+                        goto break_out;
                     case ' ':
                     case ',':
                     case '\t':
+                        /* expressions keep their whitespace inside parentheses */
+                        if(paren > 0)
+                        {
+                            break;
+                        }
+
                         cmptok_skip_triggers();
                         goto break_out;
+
+                    /* handling parentheses of expressions */
+                    case '(':
+                        paren++;
+                        break;
+                    case ')':
+                        paren -= (paren > 0);
+                        break;
                     
                     /* handling string beginnings */
                     case '"':
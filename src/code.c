@@ -25,6 +25,11 @@
 #include <la64asm/code.h>
 #include <la64asm/cmptok.h>
 #include <la64asm/diag.h>
+#include <la64asm/expr.h>
+#include <la64asm/debuginfo.h>
+#include <la64asm/section.h>
+#include <la64asm/cache.h>
+#include <la64asm/lz.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdbool.h>
@@ -32,55 +37,231 @@
 #include <sys/stat.h>
 #include <unistd.h>
 #include <fcntl.h>
-#include <sys/mman.h>
+#include <errno.h>
 
-void get_code_buffer(const char **files,
-                     int file_cnt,
-                     compiler_invocation_t *ci)
+bool code_dep_add(compiler_invocation_t *ci,
+                  const char *path)
 {
-    /* setting file count for tokenizer */
-    ci->file_cnt = file_cnt;
+    /* canonicalizing so the same file is only ever read once */
+    char *real = realpath(path, NULL);
 
-    /* allocating code array */
-    ci->file = calloc(file_cnt, sizeof(compiler_file_t));
+    if(real == NULL)
+    {
+        diag_perror(path);
+        diag_exit(EXIT_FAILURE);
+    }
 
-    /* calculating the total buffer size needed to store the code into */
-    for(int i = 0; i < file_cnt; i++)
+    for(uint64_t i = 0; i < ci->dep_cnt; i++)
+    {
+        if(strcmp(ci->dep[i].real, real) == 0)
+        {
+            free(real);
+            return false;
+        }
+    }
+
+    ci->dep = realloc(ci->dep, (ci->dep_cnt + 1) * sizeof(compiler_dep_t));
+    ci->dep[ci->dep_cnt].path = strdup(path);
+    ci->dep[ci->dep_cnt++].real = real;
+
+    /* a change to anything read means rebuilding, even to files that are not tokenized like .incbin */
+    if(ci->cache != NULL)
+    {
+        cache_file(ci->cache, real);
+    }
+
+    return true;
+}
+
+char *code_include_path(const char *from,
+                        const char *path,
+                        size_t len)
+{
+    char *res = NULL;
+
+    /* relative includes are looked up next to the including file first */
+    const char *slash = strrchr(from, '/');
+    if(path[0] != '/' && slash != NULL)
+    {
+        asprintf(&res, "%.*s/%.*s", (int)(slash - from), from, (int)len, path);
+
+        if(access(res, R_OK) == 0)
+        {
+            return res;
+        }
+
+        free(res);
+    }
+
+    return strndup(path, len);
+}
+
+static char *code_file_read(int fd,
+                            const char *path,
+                            size_t *len)
+{
+    /* getting stat */
+    struct stat fdstat;
+    if(fstat(fd, &fdstat) < 0)
+    {
+        diag_perror("fstat");
+        return NULL;
+    }
+
+    /* regular files are read in one go, pipes and terminals grow the buffer until they run dry */
+    bool regular = S_ISREG(fdstat.st_mode);
+    size_t cap = regular ? (size_t)fdstat.st_size : 0x10000;
+    char *code = malloc(cap + 2);
+
+    *len = 0;
+    for(;;)
+    {
+        if(*len == cap)
+        {
+            if(regular)
+            {
+                break;
+            }
+
+            cap *= 2;
+            code = realloc(code, cap + 2);
+        }
+
+        ssize_t got = read(fd, &code[*len], cap - *len);
+
+        if(got < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        else if(got < 0)
+        {
+            diag_perror(path);
+            free(code);
+            return NULL;
+        }
+        else if(got == 0)
+        {
+            break;
+        }
+
+        *len += got;
+    }
+
+    code[*len] = '\n';
+    code[*len + 1] = '\0';
+
+    return code;
+}
+
+static void code_file_load(compiler_invocation_t *ci,
+                           const char *path)
+{
+    /* standard input has no path to depend on and can only be read once anyway */
+    bool stdio = (strcmp(path, "-") == 0);
+
+    /* files already read or currently being read are skipped, this makes every include an include once */
+    if(!stdio && !code_dep_add(ci, path))
+    {
+        return;
+    }
+
+    /* files that did not change since an earlier invocation come from the cache */
+    compiler_cache_file_t *cf = (stdio || ci->cache == NULL) ? NULL : cache_file(ci->cache, ci->dep[ci->dep_cnt - 1].real);
+    size_t len = 0;
+    char *code = NULL;
+
+    if(cf != NULL && cf->code != NULL && !cf->stale)
+    {
+        len = cf->len;
+        code = malloc(len + 2);
+        memcpy(code, cf->code, len + 2);
+    }
+    else
     {
         /* opening file */
-        int fd = open(files[i], O_RDONLY);
+        int fd = stdio ? STDIN_FILENO : open(path, O_RDONLY);
 
         /* checking for succession */
         if(fd < 0)
         {
-            perror(files[i]);
-            exit(EXIT_FAILURE);
+            diag_perror(path);
+            diag_exit(EXIT_FAILURE);
         }
 
-        /* getting stat */
-        struct stat fdstat;
-        if(fstat(fd, &fdstat) < 0)
+        /* the file is closed before a read error ends the invocation */
+        code = code_file_read(fd, path, &len);
+
+        if(!stdio)
         {
-            perror("fstat");
-            exit(EXIT_FAILURE);
+            close(fd);
         }
 
-        /* copying name */
-        ci->file[i].path = strdup(files[i]);
-        ci->file[i].code = mmap(NULL, fdstat.st_size + 2, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if(code == NULL)
+        {
+            diag_exit(EXIT_FAILURE);
+        }
 
-        if(ci->file[i].code == MAP_FAILED)
+        if(cf != NULL)
         {
-            perror("mmap");
-            exit(EXIT_FAILURE);
+            cache_file_store(cf, code, len);
         }
+    }
 
-        read(fd, ci->file[i].code, fdstat.st_size);
+    path = stdio ? "<stdin>" : path;
 
-        ci->file[i].code[fdstat.st_size] = '\n';
-        ci->file[i].code[fdstat.st_size + 1] = '\0';
+    /* included files go in front of the file including them, until then an error in one of them lets go of this one */
+    code_resource_hold(ci, code, free);
 
-        ci->file[i].len = fdstat.st_size + 1;
+    for(char *line = code; line != NULL && *line != '\0';)
+    {
+        /* trim whitespaces */
+        while(*line == ' ' || *line == '\t')
+        {
+            line++;
+        }
+
+        if(strncmp(line, "%include%", 9) == 0)
+        {
+            char *start = strchr(line, '"');
+            char *end = (start == NULL) ? NULL : strchr(start + 1, '"');
+            char *eol = strchr(line, '\n');
+
+            if(end == NULL || end > eol)
+            {
+                fprintf(diag_file(stderr), "%s: malformed %%include%%, expected a quoted path\n", path);
+                diag_exit(EXIT_FAILURE);
+            }
+
+            char *inc = code_include_path(path, start + 1, end - start - 1);
+            code_resource_hold(ci, inc, free);
+            code_file_load(ci, inc);
+            code_resource_drop(ci, inc);
+        }
+
+        line = strchr(line, '\n');
+        line = (line == NULL) ? NULL : line + 1;
+    }
+
+    /* appending file */
+    code_resource_keep(ci, code);
+    ci->file = realloc(ci->file, (ci->file_cnt + 1) * sizeof(compiler_file_t));
+    ci->file[ci->file_cnt].path = strdup(path);
+    ci->file[ci->file_cnt].code = code;
+    ci->file[ci->file_cnt].cache = cf;
+    ci->file[ci->file_cnt++].len = len + 1;
+}
+
+void get_code_buffer(const char **files,
+                     int file_cnt,
+                     compiler_invocation_t *ci)
+{
+    /* files get appended as they and their includes are read */
+    ci->file = NULL;
+    ci->file_cnt = 0;
+
+    for(int i = 0; i < file_cnt; i++)
+    {
+        code_file_load(ci, files[i]);
     }
 }
 
@@ -92,6 +273,13 @@ void code_tokengen(compiler_invocation_t *ci)
     /* iterating through code and look for newline characters as indicator for a newline, all this to know how many lines exist here */
     for(size_t a = 0; a < ci->file_cnt; a++)
     {
+        /* files tokenized by an earlier invocation know their line count */
+        if(ci->file[a].cache != NULL && ci->file[a].cache->line != NULL)
+        {
+            line_cnt += ci->file[a].cache->line_cnt;
+            continue;
+        }
+
         for(size_t i = 0; i < ci->file[a].len; i++)
         {
             if(ci->file[a].code[i] == '\n')
@@ -108,6 +296,28 @@ void code_tokengen(compiler_invocation_t *ci)
     /* reset line count and then begin to copy */
     for(size_t a = 0; a < ci->file_cnt; a++)
     {
+        compiler_cache_file_t *cf = ci->file[a].cache;
+        uint64_t first = ci->line_cnt;
+
+        /* unchanged files skip splitting and tokenizing, only their copy is retyped below */
+        if(cf != NULL && cf->line != NULL)
+        {
+            for(uint64_t i = 0; i < cf->line_cnt; i++)
+            {
+                compiler_line_t *cl = &(ci->line[ci->line_cnt++]);
+                code_line_copy(cl, &(cf->line[i]));
+                cl->file_idx = a;
+                cl->ci = ci;
+
+                for(uint64_t t = 0; t < cl->token_cnt; t++)
+                {
+                    cl->token[t].cl = cl;
+                }
+            }
+
+            continue;
+        }
+
         line_cnt = 0;
         size_t start_off = 0;   /* this offset is used to determine the lenght of each line */
         for(size_t i = 0; i < ci->file[a].len; i++)
@@ -157,31 +367,37 @@ void code_tokengen(compiler_invocation_t *ci)
                 line_cnt++;
             }
         }
-    }
 
-    /* getting subtokens of each token */
-    for(unsigned long i = 0; i < ci->line_cnt; i++)
-    {
-        /* using cmptok in first pass to get token count */
-        for(const char *token = cmptok(ci->line[i].str); token != NULL;)
+        /* getting subtokens of each token of this file */
+        for(unsigned long i = first; i < ci->line_cnt; i++)
         {
-            /* until this is not null i will not move anywhere else than my safe space which is this while loop :3*/
-            ci->line[i].token_cnt++;
-            token = cmptok(NULL);
-        }
+            /* using cmptok in first pass to get token count */
+            for(const char *token = cmptok(ci->line[i].str); token != NULL;)
+            {
+                /* until this is not null i will not move anywhere else than my safe space which is this while loop :3*/
+                ci->line[i].token_cnt++;
+                token = cmptok(NULL);
+            }
 
-        /* allocating memory for array of subtokens */
-        ci->line[i].token = calloc(sizeof(compiler_token_t), ci->line[i].token_cnt);
+            /* allocating memory for array of subtokens */
+            ci->line[i].token = calloc(sizeof(compiler_token_t), ci->line[i].token_cnt);
 
-        /* copy subtokens */
-        ci->line[i].token_cnt = 0;
+            /* copy subtokens */
+            ci->line[i].token_cnt = 0;
 
-        /* again doing the same dance, over and over and over again, is this a carousell or why am I getting ill rn */
-        for(const char *token = cmptok(ci->line[i].str); token != NULL;)
+            /* again doing the same dance, over and over and over again, is this a carousell or why am I getting ill rn */
+            for(const char *token = cmptok(ci->line[i].str); token != NULL;)
+            {
+                ci->line[i].token[ci->line[i].token_cnt].str = strdup(token);
+                ci->line[i].token[ci->line[i].token_cnt++].cl = &(ci->line[i]);
+                token = cmptok(NULL);
+            }
+        }
+
+        /* keeping the lines before they are typed, the next invocation may take them as they are */
+        if(cf != NULL)
         {
-            ci->line[i].token[ci->line[i].token_cnt].str = strdup(token);
-            ci->line[i].token[ci->line[i].token_cnt++].cl = &(ci->line[i]);
-            token = cmptok(NULL);
+            cache_file_store_lines(cf, &(ci->line[first]), ci->line_cnt - first);
         }
     }
 
@@ -195,6 +411,42 @@ void code_tokengen(compiler_invocation_t *ci)
             continue;
         }
 
+        /* includes were resolved while reading the files */
+        if(strcmp(ci->line[i].token[0].str, "%include%") == 0)
+        {
+            ci->line[i].type = COMPILER_LINE_TYPE_INCLUDE;
+            continue;
+        }
+
+        /* checking for exports */
+        if(strcmp(ci->line[i].token[0].str, "%export%") == 0)
+        {
+            ci->line[i].type = COMPILER_LINE_TYPE_EXPORT;
+            continue;
+        }
+
+        /* checking for multi line macros and repeat blocks, their bodies are typed like any other line */
+        if(strcmp(ci->line[i].token[0].str, "%macro%") == 0)
+        {
+            ci->line[i].type = COMPILER_LINE_TYPE_MACROBEGIN;
+            continue;
+        }
+        else if(strcmp(ci->line[i].token[0].str, "%endmacro%") == 0)
+        {
+            ci->line[i].type = COMPILER_LINE_TYPE_MACROEND;
+            continue;
+        }
+        else if(strcmp(ci->line[i].token[0].str, ".rept") == 0)
+        {
+            ci->line[i].type = COMPILER_LINE_TYPE_REPT;
+            continue;
+        }
+        else if(strcmp(ci->line[i].token[0].str, ".endr") == 0)
+        {
+            ci->line[i].type = COMPILER_LINE_TYPE_ENDR;
+            continue;
+        }
+
         /* lets go */
         if(ci->line[i].token_cnt < 2)
         {
@@ -234,7 +486,8 @@ void code_tokengen(compiler_invocation_t *ci)
             /* checking if its a section */
             if(strcmp(ci->line[i].token[0].str, "section") == 0)
             {
-                section_mode = 0b1;
+                /* code sections hold assembly, everything else holds data entries */
+                section_mode = ci->line[i].token_cnt < 2 || code_section_kind(ci->line[i].token[1].str) != COMPILER_SECTION_KIND_CODE;
                 ci->line[i].type = COMPILER_LINE_TYPE_SECTION;
                 continue;
             }
@@ -261,14 +514,504 @@ void code_tokengen(compiler_invocation_t *ci)
     }
 }
 
+void code_line_relink(compiler_invocation_t *ci)
+{
+    /* pointing every token back at the line it now lives in */
+    for(uint64_t i = 0; i < ci->line_cnt; i++)
+    {
+        for(uint64_t a = 0; a < ci->line[i].token_cnt; a++)
+        {
+            ci->line[i].token[a].cl = &(ci->line[i]);
+        }
+    }
+}
+
+void code_line_copy(compiler_line_t *dst,
+                    compiler_line_t *src)
+{
+    /* every copy owns its string and tokens, later passes rewrite them in place */
+    *dst = *src;
+    dst->str = strdup(src->str);
+    dst->token = calloc(src->token_cnt, sizeof(compiler_token_t));
+
+    for(uint64_t a = 0; a < src->token_cnt; a++)
+    {
+        dst->token[a] = src->token[a];
+        dst->token[a].str = strdup(src->token[a].str);
+    }
+}
+
+void code_line_free(compiler_line_t *cl)
+{
+    /* every line owns its string and its tokens */
+    for(uint64_t a = 0; a < cl->token_cnt; a++)
+    {
+        free(cl->token[a].str);
+    }
+
+    free(cl->token);
+    free(cl->str);
+
+    /* freeing twice is harmless, a job unwinding from an error may do that */
+    cl->token = NULL;
+    cl->token_cnt = 0;
+    cl->str = NULL;
+}
+
+void code_resource_hold(compiler_invocation_t *ci,
+                        void *ptr,
+                        compiler_release_t release)
+{
+    /* errors unwind past the pass holding it, the invocation lets go of it then */
+    ci->res = realloc(ci->res, (ci->res_cnt + 1) * sizeof(compiler_resource_t));
+    ci->res[ci->res_cnt].ptr = ptr;
+    ci->res[ci->res_cnt++].release = release;
+}
+
+static compiler_release_t code_resource_remove(compiler_invocation_t *ci,
+                                               void *ptr)
+{
+    /* passes let go in the reverse order they took, the search ends early */
+    for(uint64_t i = ci->res_cnt; i-- > 0;)
+    {
+        if(ci->res[i].ptr == ptr)
+        {
+            compiler_release_t release = ci->res[i].release;
+            memmove(&(ci->res[i]), &(ci->res[i + 1]), (ci->res_cnt - i - 1) * sizeof(compiler_resource_t));
+            ci->res_cnt--;
+            return release;
+        }
+    }
+
+    return NULL;
+}
+
+void code_resource_drop(compiler_invocation_t *ci,
+                        void *ptr)
+{
+    compiler_release_t release = code_resource_remove(ci, ptr);
+
+    if(release != NULL)
+    {
+        release(ptr);
+    }
+}
+
+void code_resource_keep(compiler_invocation_t *ci,
+                        void *ptr)
+{
+    /* ownership moved into the invocation itself */
+    code_resource_remove(ci, ptr);
+}
+
+void code_release_file(void *fp)
+{
+    fclose(fp);
+}
+
+reloc_table_entry *code_reloc_add(compiler_invocation_t *ci)
+{
+    /* growing the table by doubling it, entries point into the image and never at each other */
+    if(ci->rtlb_cnt == ci->rtlb_cap)
+    {
+        ci->rtlb_cap = (ci->rtlb_cap == 0) ? 256 : ci->rtlb_cap * 2;
+        ci->rtlb = realloc(ci->rtlb, ci->rtlb_cap * sizeof(reloc_table_entry));
+    }
+
+    reloc_table_entry *rt = &(ci->rtlb[ci->rtlb_cnt++]);
+    memset(rt, 0, sizeof(reloc_table_entry));
+    return rt;
+}
+
+void code_image_align(compiler_invocation_t *ci,
+                      compiler_token_t *ct,
+                      uint64_t align,
+                      uint8_t fill)
+{
+    /* alignment has to be a power of two */
+    if(align == 0 || (align & (align - 1)) != 0)
+    {
+        diag_error(ct, "alignment %lu is not a power of two\n", align);
+    }
+
+    uint64_t pad = (align - (ci->image_addr & (align - 1))) & (align - 1);
+
+    if(ci->image_addr + pad > sizeof(ci->image))
+    {
+        diag_error(ct, "alignment to %lu exceeds the image\n", align);
+    }
+
+    memset(&(ci->image[ci->image_addr]), fill, pad);
+    ci->image_addr += pad;
+}
+
+bool code_token_align_value(compiler_line_t *cl,
+                            uint64_t *align)
+{
+    /* checking if its a alignment directive in the first place */
+    if(cl->token_cnt == 0 ||
+       (strcmp(cl->token[0].str, ".align") != 0 &&
+        strcmp(cl->token[0].str, ".balign") != 0))
+    {
+        return false;
+    }
+
+    if(cl->token_cnt < 2 || cl->token_cnt > 3)
+    {
+        diag_error(&(cl->token[0]), "\"%s\" takes a alignment and a optional fill byte\n", cl->token[0].str);
+    }
+
+    /* both take the alignment in bytes */
+    *align = expr_eval_constant(cl->ci, &(cl->token[1]));
+
+    if(*align == 0 || (*align & (*align - 1)) != 0)
+    {
+        diag_error(&(cl->token[1]), "alignment %lu is not a power of two\n", *align);
+    }
+
+    return true;
+}
+
+bool code_token_align(compiler_line_t *cl,
+                      uint8_t fill)
+{
+    uint64_t align = 0;
+    if(!code_token_align_value(cl, &align))
+    {
+        return false;
+    }
+
+    /* a explicit fill overrides the default */
+    if(cl->token_cnt == 3)
+    {
+        fill = expr_eval_constant(cl->ci, &(cl->token[2]));
+    }
+
+    code_image_align(cl->ci, &(cl->token[0]), align, fill);
+    return true;
+}
+
+static void code_binary_compress(compiler_invocation_t *ci,
+                                 int fd)
+{
+    /* the loader needs entry and .bss before the first block arrives */
+    la64_lz_header_t hdr = {
+        .magic = LA64_LZ_MAGIC,
+        .version = LA64_LZ_VERSION,
+        .block_size = LA64_LZ_BLOCK_SIZE,
+        .size = ci->image_addr,
+    };
+
+    if(ci->image_addr >= COMPILER_IMAGE_HEADER_SIZE)
+    {
+        memcpy(&(hdr.entry), &(ci->image[COMPILER_IMAGE_HEADER_ENTRY]), sizeof(uint64_t));
+        memcpy(&(hdr.bss_size), &(ci->image[COMPILER_IMAGE_HEADER_BSS]), sizeof(uint64_t));
+    }
+
+    write(fd, &hdr, sizeof(hdr));
+
+    /* blocks that do not shrink are stored */
+    uint8_t *packed = malloc(la64_lz_bound(LA64_LZ_BLOCK_SIZE));
+    for(uint64_t off = 0; off < ci->image_addr; off += LA64_LZ_BLOCK_SIZE)
+    {
+        uint64_t len = (ci->image_addr - off < LA64_LZ_BLOCK_SIZE) ? ci->image_addr - off : LA64_LZ_BLOCK_SIZE;
+        uint32_t size = la64_lz_compress_block(&(ci->image[off]), len, packed, la64_lz_bound(LA64_LZ_BLOCK_SIZE));
+
+        if(size == 0 || size >= len)
+        {
+            size = len | LA64_LZ_BLOCK_STORED;
+            write(fd, &size, sizeof(size));
+            write(fd, &(ci->image[off]), len);
+        }
+        else
+        {
+            write(fd, &size, sizeof(size));
+            write(fd, packed, size);
+        }
+    }
+
+    free(packed);
+}
+
 void code_binary_spitout(compiler_invocation_t *ci)
 {
     /* open output file */
-    int fd = open("a.out", O_RDWR | O_CREAT | O_TRUNC, 0666);
+    int fd = open(ci->opt->output, O_RDWR | O_CREAT | O_TRUNC, 0666);
+
+    if(fd < 0)
+    {
+        diag_perror(ci->opt->output);
+        diag_exit(EXIT_FAILURE);
+    }
 
     /* writing output file */
-    write(fd, ci->image, ci->image_addr);
+    if(ci->opt->flags & COMPILER_FLAG_COMPRESS)
+    {
+        code_binary_compress(ci, fd);
+    }
+    else
+    {
+        write(fd, ci->image, ci->image_addr);
+    }
 
     /* closing file descriptor */
     close(fd);
-}
\ No newline at end of file
+}
+
+static void code_depfile_path(FILE *fp,
+                              const char *path)
+{
+    /* make and ninja both want spaces escaped */
+    for(; *path != '\0'; path++)
+    {
+        if(*path == ' ' || *path == '#')
+        {
+            fputc('\\', fp);
+        }
+        else if(*path == '$')
+        {
+            fputc('$', fp);
+        }
+
+        fputc(*path, fp);
+    }
+}
+
+void code_depfile_spitout(compiler_invocation_t *ci)
+{
+    /* checking if a dependency file was requested in the first place */
+    if(ci->opt->depfile == NULL)
+    {
+        return;
+    }
+
+    FILE *fp = fopen(ci->opt->depfile, "w");
+
+    if(fp == NULL)
+    {
+        diag_perror(ci->opt->depfile);
+        diag_exit(EXIT_FAILURE);
+    }
+
+    /* the output depends on every file read */
+    code_depfile_path(fp, ci->opt->output);
+    fputc(':', fp);
+
+    for(uint64_t i = 0; i < ci->dep_cnt; i++)
+    {
+        fputs(" \\\n  ", fp);
+        code_depfile_path(fp, ci->dep[i].path);
+    }
+
+    fputc('\n', fp);
+    fclose(fp);
+}
+
+static char code_map_type(compiler_invocation_t *ci,
+                          uint64_t idx,
+                          const bool *bss)
+{
+    compiler_label_t *label = &(ci->label[idx]);
+
+    /* labels the compiler made up have no origin */
+    if(label->ctlink == NULL)
+    {
+        return 'A';
+    }
+
+    switch(label->ctlink->cl->type)
+    {
+        case COMPILER_LINE_TYPE_GLOBAL_LABEL:
+            return 'T';
+        case COMPILER_LINE_TYPE_LOCAL_LABEL:
+            return 't';
+        default:
+            return bss[idx] ? 'B' : 'D';
+    }
+}
+
+static int code_map_compare(const void *a,
+                            const void *b)
+{
+    const compiler_label_t *la = *(compiler_label_t* const*)a;
+    const compiler_label_t *lb = *(compiler_label_t* const*)b;
+
+    if(la->addr != lb->addr)
+    {
+        return (la->addr < lb->addr) ? -1 : 1;
+    }
+
+    return strcmp(la->name, lb->name);
+}
+
+void code_map_spitout(compiler_invocation_t *ci)
+{
+    /* checking if a map file was requested in the first place */
+    if(ci->opt->map == NULL)
+    {
+        return;
+    }
+
+    FILE *fp = fopen(ci->opt->map, "w");
+
+    if(fp == NULL)
+    {
+        diag_perror(ci->opt->map);
+        diag_exit(EXIT_FAILURE);
+    }
+
+    /* .bss labels are only known by index */
+    bool *bss = calloc(ci->label_cnt, sizeof(bool));
+    for(uint64_t i = 0; i < ci->bss_label_cnt; i++)
+    {
+        bss[ci->bss_label[i]] = true;
+    }
+
+    /* nm style, one "address type name" per line in address order */
+    compiler_label_t **sorted = calloc(ci->label_cnt, sizeof(compiler_label_t*));
+    for(uint64_t i = 0; i < ci->label_cnt; i++)
+    {
+        sorted[i] = &(ci->label[i]);
+    }
+
+    qsort(sorted, ci->label_cnt, sizeof(compiler_label_t*), code_map_compare);
+
+    for(uint64_t i = 0; i < ci->label_cnt; i++)
+    {
+        fprintf(fp, "%016llx %c %s\n", (unsigned long long)sorted[i]->addr, code_map_type(ci, sorted[i] - ci->label, bss), sorted[i]->name);
+    }
+
+    free(sorted);
+    free(bss);
+    fclose(fp);
+}
+
+typedef struct {
+    char *buf;                              /* strings, each with its terminator */
+    uint64_t size;                          /* bytes used */
+    uint64_t cap;                           /* bytes allocated */
+} code_strtab_t;
+
+static uint32_t code_strtab_add(code_strtab_t *st,
+                                const char *str)
+{
+    uint64_t len = strlen(str) + 1;
+
+    if(st->size + len > st->cap)
+    {
+        st->cap = (st->cap * 2 > st->size + len) ? st->cap * 2 : st->size + len;
+        st->buf = realloc(st->buf, st->cap);
+    }
+
+    memcpy(&(st->buf[st->size]), str, len);
+    st->size += len;
+
+    return st->size - len;
+}
+
+static int code_debug_line_compare(const void *a,
+                                   const void *b)
+{
+    const compiler_line_t *la = *(compiler_line_t* const*)a;
+    const compiler_line_t *lb = *(compiler_line_t* const*)b;
+
+    if(la->addr != lb->addr)
+    {
+        return (la->addr < lb->addr) ? -1 : 1;
+    }
+
+    /* lines sharing an address keep their source order */
+    return (la < lb) ? -1 : (la > lb);
+}
+
+void code_debuginfo_spitout(compiler_invocation_t *ci)
+{
+    /* checking if debug info was requested in the first place */
+    if(ci->opt->debuginfo == NULL)
+    {
+        return;
+    }
+
+    FILE *fp = fopen(ci->opt->debuginfo, "wb");
+
+    if(fp == NULL)
+    {
+        diag_perror(ci->opt->debuginfo);
+        diag_exit(EXIT_FAILURE);
+    }
+
+    code_strtab_t st = { 0 };
+
+    /* symbols in the same order and with the same kinds as the map */
+    bool *bss = calloc(ci->label_cnt, sizeof(bool));
+    for(uint64_t i = 0; i < ci->bss_label_cnt; i++)
+    {
+        bss[ci->bss_label[i]] = true;
+    }
+
+    compiler_label_t **sorted = calloc(ci->label_cnt, sizeof(compiler_label_t*));
+    for(uint64_t i = 0; i < ci->label_cnt; i++)
+    {
+        sorted[i] = &(ci->label[i]);
+    }
+
+    qsort(sorted, ci->label_cnt, sizeof(compiler_label_t*), code_map_compare);
+
+    la64_debug_symbol_t *sym = calloc(ci->label_cnt, sizeof(la64_debug_symbol_t));
+    for(uint64_t i = 0; i < ci->label_cnt; i++)
+    {
+        sym[i].addr = sorted[i]->addr;
+        sym[i].name = code_strtab_add(&st, sorted[i]->name);
+        sym[i].type = code_map_type(ci, sorted[i] - ci->label, bss);
+    }
+
+    /* every line that produced code, sections place them out of line order */
+    uint32_t *file = calloc(ci->file_cnt, sizeof(uint32_t));
+    for(uint64_t i = 0; i < ci->file_cnt; i++)
+    {
+        file[i] = code_strtab_add(&st, ci->file[i].path);
+    }
+
+    compiler_line_t **coded = calloc(ci->line_cnt, sizeof(compiler_line_t*));
+    uint64_t line_cnt = 0;
+    for(uint64_t i = 0; i < ci->line_cnt; i++)
+    {
+        if(ci->line[i].type == COMPILER_LINE_TYPE_ASM && ci->line[i].addr != 0)
+        {
+            coded[line_cnt++] = &(ci->line[i]);
+        }
+    }
+
+    qsort(coded, line_cnt, sizeof(compiler_line_t*), code_debug_line_compare);
+
+    la64_debug_line_t *line = calloc(line_cnt, sizeof(la64_debug_line_t));
+    for(uint64_t i = 0; i < line_cnt; i++)
+    {
+        line[i].addr = coded[i]->addr;
+        line[i].file = file[coded[i]->file_idx];
+        line[i].line = coded[i]->line_num;
+    }
+
+    /* header, symbols, lines and strings back to back */
+    la64_debug_header_t hdr = { .magic = LA64_DEBUG_MAGIC, .version = LA64_DEBUG_VERSION };
+    hdr.sym_off = sizeof(hdr);
+    hdr.sym_cnt = ci->label_cnt;
+    hdr.line_off = hdr.sym_off + hdr.sym_cnt * sizeof(la64_debug_symbol_t);
+    hdr.line_cnt = line_cnt;
+    hdr.str_off = hdr.line_off + hdr.line_cnt * sizeof(la64_debug_line_t);
+    hdr.str_size = st.size;
+
+    fwrite(&hdr, sizeof(hdr), 1, fp);
+    fwrite(sym, sizeof(la64_debug_symbol_t), hdr.sym_cnt, fp);
+    fwrite(line, sizeof(la64_debug_line_t), hdr.line_cnt, fp);
+    fwrite(st.buf, 1, st.size, fp);
+
+    free(line);
+    free(coded);
+    free(file);
+    free(sym);
+    free(sorted);
+    free(bss);
+    free(st.buf);
+    fclose(fp);
+}
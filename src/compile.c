@@ -24,6 +24,8 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
 #include <la64asm/compile.h>
 #include <la64asm/code.h>
 #include <la64asm/label.h>
@@ -31,42 +33,185 @@
 #include <la64asm/section.h>
 #include <la64asm/macro.h>
 #include <la64asm/diag.h>
+#include <la64asm/strength.h>
+#include <la64asm/branch.h>
+#include <la64asm/strip.h>
+#include <la64asm/layout.h>
+#include <la64asm/instrument.h>
+#include <la64asm/ir.h>
+#include <la64asm/template.h>
 
-compiler_invocation_t *compiler_invocation_alloc(void)
+compiler_invocation_t *compiler_invocation_alloc(const compiler_options_t *opt)
 {
     compiler_invocation_t *ci = calloc(1, sizeof(compiler_invocation_t));
-    ci->image_addr = 8;
+    ci->opt = opt;
+    ci->image_addr = COMPILER_IMAGE_HEADER_SIZE;
     return ci;
 }
 
-void compiler_invocation_dealloc(compiler_invocation_t *ci)
+static void compiler_invocation_release(compiler_invocation_t *ci)
 {
-    /* todo: this must be redone from scratch */
+    /* whatever a pass held when an error ended it, the last taken first */
+    for(uint64_t i = ci->res_cnt; i-- > 0;)
+    {
+        ci->res[i].release(ci->res[i].ptr);
+    }
+
+    /* files as they were read and everything they depend on */
+    for(size_t i = 0; i < ci->file_cnt; i++)
+    {
+        free(ci->file[i].path);
+        free(ci->file[i].code);
+    }
+
+    for(uint64_t i = 0; i < ci->dep_cnt; i++)
+    {
+        free(ci->dep[i].path);
+        free(ci->dep[i].real);
+    }
+
+    /* lines, the ones held by macros included */
+    for(uint64_t i = 0; i < ci->line_cnt; i++)
+    {
+        code_line_free(&(ci->line[i]));
+    }
+
+    for(uint64_t i = 0; i < ci->macro_cnt; i++)
+    {
+        compiler_macro_t *cm = &(ci->macro[i]);
+
+        for(uint64_t a = 0; a < cm->param_cnt; a++)
+        {
+            free(cm->param[a]);
+        }
+
+        for(uint64_t a = 0; a < cm->body_cnt; a++)
+        {
+            code_line_free(&(cm->body[a]));
+        }
+
+        for(uint64_t m = 0; m < cm->memo_cnt; m++)
+        {
+            for(uint64_t a = 0; a < cm->memo[m].line_cnt; a++)
+            {
+                code_line_free(&(cm->memo[m].line[a]));
+            }
+
+            free(cm->memo[m].key);
+            free(cm->memo[m].line);
+        }
+
+        free(cm->value);
+        free(cm->param);
+        free(cm->body);
+        free(cm->memo);
+    }
+
+    for(uint64_t i = 0; i < ci->section_cnt; i++)
+    {
+        free(ci->section[i].name);
+    }
+
+    /* names are interned, so labels and relocations own nothing else */
+    free(ci->ir.line);
+    free(ci->ir.opcode);
+    free(ci->ir.operand_cnt);
+    free(ci->ir.operand);
+    free(ci->ir.kind);
+    free(ci->ir.value);
+    free(ci->ir.sym);
+    free(ci->ir.sub);
+
+    free(ci->file);
+    free(ci->dep);
+    free(ci->line);
+    free(ci->macro);
+    free(ci->section);
+    free(ci->label);
+    free(ci->label_hash);
+    free(ci->bss_label);
+    free(ci->rtlb);
+    free(ci->res);
 }
 
-void compile_files(const char **files,
-                   int file_cnt)
+void compiler_invocation_reset(compiler_invocation_t *ci,
+                               const compiler_options_t *opt)
 {
-    /* allocating compiler invocation */
-    compiler_invocation_t *ci = compiler_invocation_alloc();
+    /* only what was written is cleared, the encoder may write a template past the end */
+    uint64_t used = ci->image_addr + sizeof(la64_template_bits_t);
+    used = (used > sizeof(ci->image)) ? sizeof(ci->image) : used;
+
+    compiler_cache_t *cache = ci->cache;
+    compiler_invocation_release(ci);
+
+    memset(ci, 0, offsetof(compiler_invocation_t, image));
+    memset(ci->image, 0, used);
+    memset(&(ci->image_addr), 0, sizeof(compiler_invocation_t) - offsetof(compiler_invocation_t, image_addr));
+
+    ci->opt = opt;
+    ci->cache = cache;
+    ci->image_addr = COMPILER_IMAGE_HEADER_SIZE;
+}
 
+void compiler_invocation_dealloc(compiler_invocation_t *ci)
+{
+    compiler_invocation_release(ci);
+    free(ci);
+}
+
+void compile_invocation(compiler_invocation_t *ci,
+                        const char **files,
+                        int file_cnt)
+{
     /* gathering code */
     get_code_buffer(files, file_cnt, ci);
 
     /* generating tokens,labels,sections out of the code */
     code_tokengen(ci);
 
+    /* expanding macros, this can add lines */
+    code_token_macro(ci);
+
+    /* counting blocks if requested, this adds lines and a .bss entry */
+    code_token_instrument(ci);
+
+    /* sorting every line into its section */
+    code_token_section_assign(ci);
+
     /* allocate space for the low level compiler to put resolved addresses at */
     code_token_label(ci);
+
+    /* optimizing what is about to be compiled */
+    code_token_branch_optimize(ci);
+    code_token_dead_strip(ci);
+    code_token_layout(ci);
+
+    /* lowering the surviving instructions into the compact form the encoder reads */
+    code_ir_build(ci);
+    code_ir_strength_reduce(ci);
+
+    /* laying out what survived, section by section, code is compiled to machine code on the way */
     code_token_section(ci);
-    code_token_macro(ci);
 
-    /* finally compiling it to machine code */
+    /* placing .bss and resolving relocations */
     la64_compiler_lowlevel(ci);
 
     /* insert entry */
     code_token_label_insert_start(ci);
+    code_token_section_insert_bss(ci);
 
     /* spitting out binary */
     code_binary_spitout(ci);
+    code_depfile_spitout(ci);
+    code_map_spitout(ci);
+    code_debuginfo_spitout(ci);
+}
+
+void compile_files(const char **files,
+                   int file_cnt,
+                   const compiler_options_t *opt)
+{
+    compiler_invocation_t *ci = compiler_invocation_alloc(opt);
+    compile_invocation(ci, files, file_cnt);
+    compiler_invocation_dealloc(ci);
 }
@@ -28,153 +28,280 @@
 #include <stdlib.h>
 #include <string.h>
 #include <stdbool.h>
-#include <lautils/parser.h>
 #include <la64asm/opcode.h>
-#include <la64asm/register.h>
+#include <la64asm/intern.h>
+#include <la64asm/ir.h>
+#include <la64asm/template.h>
+#include <la64asm/code.h>
+#include <la64asm/section.h>
 
 #include <lautils/bitwalker.h>
 
-bool la64_compiler_lowcodeline(compiler_line_t *cl)
+static void la64_compiler_write_imm(bitwalker_t *bw,
+                                    uint64_t value)
 {
-    /* accessing compiler invocation */
-    compiler_invocation_t *ci = cl->ci;
-
-    /* parameter count check */
-    if(cl->token_cnt <= 0)
+    /* now we gonna have to check how large this is ;w; */
+    if(value <= 0xFF)
     {
-        diag_error(&(cl->token[0]), "insufficient operands\n");
+        bitwalker_write(bw, LA64_PARAMETER_CODING_IMM8, 3);
+        bitwalker_write(bw, value, 8);
     }
-    else if(cl->token_cnt > 32)
+    else if(value <= 0xFFFF)
     {
-        diag_error(&(cl->token[0]), "holy smokes, why soo many operands, maximum is 32 operands in 64bit lightweight architecture\n");
+        bitwalker_write(bw, LA64_PARAMETER_CODING_IMM16, 3);
+        bitwalker_write(bw, value, 16);
     }
+    else if(value <= 0xFFFFFFFF)
+    {
+        bitwalker_write(bw, LA64_PARAMETER_CODING_IMM32, 3);
+        bitwalker_write(bw, value, 32);
+    }
+    else
+    {
+        bitwalker_write(bw, LA64_PARAMETER_CODING_IMM64, 3);
+        bitwalker_write(bw, value, 64);
+    }
+}
+
+static void la64_compiler_reloc(compiler_invocation_t *ci,
+                                uint64_t instr,
+                                uint64_t operand,
+                                bitwalker_t *bw)
+{
+    compiler_ir_t *ir = &(ci->ir);
+    uint64_t op = ir->operand[instr] + operand;
+
+    reloc_table_entry *rt = code_reloc_add(ci);
+    rt->name = ir->sym[op];
+    rt->sub = ir->sub[op];
+    rt->addend = ir->value[op];
+    rt->bw = *bw;
+    rt->ctlink = code_ir_token(ci, instr, operand);
+}
+
+uint64_t la64_compiler_encode_bitwalker(compiler_invocation_t *ci,
+                                        uint64_t instr,
+                                        uint8_t *out,
+                                        bool reloc)
+{
+    compiler_ir_t *ir = &(ci->ir);
 
     /* initilize bitwalker */
     bitwalker_t bw;
-    bitwalker_init(&bw, &(ci->image[ci->image_addr]), 512, BW_LITTLE_ENDIAN);
+    bitwalker_init(&bw, out, 512, BW_LITTLE_ENDIAN);
 
-    /* getting opcode entry if it exists */
-    opcode_entry_t *opce = opcode_from_string(cl->token[0].str);
+    /* setting opcode */
+    bitwalker_write(&bw, ir->opcode[instr], 8);
 
-    if(opce == NULL)
+    switch(ir->opcode[instr])
     {
-        diag_error(&(cl->token[0]), "illegal opcode \"%s\"\n", cl->token[0].str);
+        case LA64_OPCODE_HLT:
+        case LA64_OPCODE_NOP:
+        case LA64_OPCODE_RET:
+            return bitwalker_bytes_used(&bw);
+        default:
+            break;
     }
-    else
+
+    /* encoding parameters, everything was classified when the IR was built */
+    for(uint64_t i = 0; i < ir->operand_cnt[instr]; i++)
     {
-        /* setting opcode from entry */
-        bitwalker_write(&bw, opce->opcode, 8);
+        uint64_t op = ir->operand[instr] + i;
 
-        switch(opce->opcode)
+        switch(ir->kind[op])
         {
-            case LA64_OPCODE_HLT:
-            case LA64_OPCODE_NOP:
-            case LA64_OPCODE_RET:
-                goto skip_parse;
+            case COMPILER_IR_OPERAND_REG:
+                bitwalker_write(&bw, LA64_PARAMETER_CODING_REG, 3);
+                bitwalker_write(&bw, ir->value[op], 5);
+                break;
+            case COMPILER_IR_OPERAND_IMM:
+                la64_compiler_write_imm(&bw, ir->value[op]);
+                break;
             default:
+                /* labels are always 64bit and therefore a entry in the relocation table ;) */
+                bitwalker_write(&bw, LA64_PARAMETER_CODING_IMM64, 3);
+
+                if(reloc)
+                {
+                    la64_compiler_reloc(ci, instr, i, &bw);
+                }
+
+                /* skip the 64bit for now */
+                bitwalker_skip(&bw, 64);
                 break;
         }
     }
 
-    /* parse parameters */
-    for(uint64_t i = 1; i < cl->token_cnt; i++)
+    bitwalker_write(&bw, LA64_PARAMETER_CODING_INSTR_END, 3);
+
+    return bitwalker_bytes_used(&bw);
+}
+
+uint64_t la64_compiler_encode_template(compiler_invocation_t *ci,
+                                       uint64_t instr,
+                                       uint8_t *out,
+                                       bool reloc)
+{
+    compiler_ir_t *ir = &(ci->ir);
+    uint8_t opcode = ir->opcode[instr];
+    uint8_t cnt = ir->operand_cnt[instr];
+
+    /* those are the opcode alone */
+    if(opcode == LA64_OPCODE_HLT ||
+       opcode == LA64_OPCODE_NOP ||
+       opcode == LA64_OPCODE_RET)
     {
-        /* parsing value */
-        parser_return_t pr = parse_value_from_string(cl->token[i].str);
+        out[0] = opcode;
+        return 1;
+    }
 
-        /* checking for intermediates */
-        if(pr.type != laParserValueTypeString)
-        {
-            /* now we gonna have to check how large this is ;w; */
-            if(pr.value <= 0xFF)
-            {
-                bitwalker_write(&bw, LA64_PARAMETER_CODING_IMM8, 3);
-                bitwalker_write(&bw, pr.value, 8);
-            }
-            else if(pr.value <= 0xFFFF)
-            {
-                bitwalker_write(&bw, LA64_PARAMETER_CODING_IMM16, 3);
-                bitwalker_write(&bw, pr.value, 16);
-            }
-            else if(pr.value <= 0xFFFFFFFF)
-            {
-                bitwalker_write(&bw, LA64_PARAMETER_CODING_IMM32, 3);
-                bitwalker_write(&bw, pr.value, 32);
-            }
-            else if(pr.value <= 0xFFFFFFFFFFFFFFFF)
-            {
-                bitwalker_write(&bw, LA64_PARAMETER_CODING_IMM64, 3);
-                bitwalker_write(&bw, pr.value, 64);
-            }
+    if(cnt > 2)
+    {
+        return 0;
+    }
 
-            continue;
-        }
+    /* picking the shape */
+    uint8_t cls[2] = { 0 };
+    uint64_t val[2] = { 0 };
 
-        /* checking for register */
-        register_entry_t *reg = register_from_string(cl->token[i].str);
+    for(uint8_t i = 0; i < cnt; i++)
+    {
+        uint64_t op = ir->operand[instr] + i;
 
-        if(reg != NULL)
+        switch(ir->kind[op])
         {
-            bitwalker_write(&bw, LA64_PARAMETER_CODING_REG, 3);
-            bitwalker_write(&bw, reg->reg, 5);
-            continue;
+            case COMPILER_IR_OPERAND_REG:
+                cls[i] = LA64_TEMPLATE_REG;
+                val[i] = ir->value[op];
+                break;
+            case COMPILER_IR_OPERAND_IMM:
+                cls[i] = la64_template_imm_class(ir->value[op]);
+                val[i] = ir->value[op];
+                break;
+            default:
+                cls[i] = LA64_TEMPLATE_IMM64;
+                break;
         }
+    }
+
+    const la64_template_t *t = &la64_template[(cnt == 0) ? 0 : (cnt == 1) ? 1 + cls[0] : 6 + cls[0] * 5 + cls[1]];
+
+    if(t->bits == 0)
+    {
+        return 0;
+    }
 
-        /* set mode to 64bit lmfao */
-        bitwalker_write(&bw, LA64_PARAMETER_CODING_IMM64, 3);
+    /* the codings are fixed by the shape, only opcode and values are put in */
+    la64_template_bits_t bits = t->codings | opcode;
 
-        /* it must be a label and therefore a entry in the new relocation table ;) */
-        /* checking label type in question */
-        char *label = NULL;
+    for(uint8_t i = 0; i < cnt; i++)
+    {
+        bits |= (la64_template_bits_t)val[i] << t->shift[i];
+    }
 
-        /* checking for local label */
-        if(cl->token[i].str[0] == '.')
-        {
-            asprintf(&label, "%s%s", ci->label_scope, cl->token[i].str);
-        }
-        else
+    la64_template_store(out, bits);
+
+    /* relocations still want a bitwalker right at their value */
+    for(uint8_t i = 0; reloc && i < cnt; i++)
+    {
+        if(ir->kind[ir->operand[instr] + i] == COMPILER_IR_OPERAND_SYM)
         {
-            label = strdup(cl->token[i].str);
+            bitwalker_t bw;
+            bitwalker_init(&bw, out, 512, BW_LITTLE_ENDIAN);
+            bitwalker_skip(&bw, t->shift[i]);
+            la64_compiler_reloc(ci, instr, i, &bw);
         }
+    }
+
+    return (t->bits + 7) / 8;
+}
 
-        ci->rtlb[ci->rtlb_cnt].name = label;
-        ci->rtlb[ci->rtlb_cnt].bw = bw;
-        ci->rtlb[ci->rtlb_cnt++].ctlink = &(cl->token[i]);
+bool la64_compiler_lowcodeline(compiler_line_t *cl)
+{
+    /* accessing compiler invocation and the lowered instruction */
+    compiler_invocation_t *ci = cl->ci;
+    uint8_t *out = &(ci->image[ci->image_addr]);
+    uint64_t len = 0;
 
-        /* skip the 64bit for now */
-        bitwalker_skip(&bw, 64);
+    /* templates store whole words, so they need some room */
+    if(ci->image_addr + sizeof(la64_template_bits_t) <= sizeof(ci->image))
+    {
+        len = la64_compiler_encode_template(ci, cl->instr, out, true);
     }
 
-    bitwalker_write(&bw, LA64_PARAMETER_CODING_INSTR_END, 3);
+    if(len == 0)
+    {
+        len = la64_compiler_encode_bitwalker(ci, cl->instr, out, true);
+    }
+    else if(ci->opt->flags & COMPILER_FLAG_VERIFY_ENCODING)
+    {
+        /* the bitwalker is the reference the templates are checked against */
+        uint8_t ref[512] = { 0 };
+        uint64_t ref_len = la64_compiler_encode_bitwalker(ci, cl->instr, ref, false);
 
-skip_parse:
+        if(ref_len != len || memcmp(ref, out, len) != 0)
+        {
+            diag_error(&(cl->token[0]), "template encoding of \"%s\" differs from the bitwalker encoding\n", cl->str);
+        }
+    }
 
-    ci->image_addr += bitwalker_bytes_used(&bw);
+    ci->image_addr += len;
 
     return 0;
 }
 
-void la64_compiler_lowlevel(compiler_invocation_t *ci)
+void la64_compiler_lowsection(compiler_invocation_t *ci,
+                              uint64_t section)
 {
+    /* local labels are defined in the scope of the last global label in source order, whatever section it is in */
+    ci->label_scope = NULL;
+
     /* iterate through each token */
     for(uint64_t i = 0; i < ci->line_cnt; i++)
     {
+        if(ci->line[i].section != section)
+        {
+            if(ci->line[i].type == COMPILER_LINE_TYPE_GLOBAL_LABEL)
+            {
+                ci->label_scope = intern_n(ci->line[i].token[0].str, strlen(ci->line[i].token[0].str) - 1);
+            }
+
+            continue;
+        }
+
         /* checking for label */
         if(ci->line[i].type == COMPILER_LINE_TYPE_GLOBAL_LABEL ||
            ci->line[i].type == COMPILER_LINE_TYPE_LOCAL_LABEL)
         {
+            /* aligning function entries if requested */
+            if(ci->line[i].type == COMPILER_LINE_TYPE_GLOBAL_LABEL &&
+               ci->opt->align_functions > 1)
+            {
+                code_image_align(ci, &(ci->line[i].token[0]), ci->opt->align_functions, LA64_OPCODE_NOP);
+            }
+
             /* insert into labels */
             code_token_label_append(&(ci->line[i].token[0]));
         }
         else if(ci->line[i].type == COMPILER_LINE_TYPE_ASM)
         {
-            la64_compiler_lowcodeline(&(ci->line[i]));
+            /* code is padded with nops, they are a single byte */
+            if(!code_token_align(&(ci->line[i]), LA64_OPCODE_NOP))
+            {
+                ci->line[i].addr = ci->image_addr;
+                la64_compiler_lowcodeline(&(ci->line[i]));
+            }
         }
     }
+}
+
+void la64_compiler_lowlevel(compiler_invocation_t *ci)
+{
+    /* .bss goes behind the image */
+    code_token_section_place_bss(ci);
 
-    /* append binary end label */
-    ci->label[ci->label_cnt].addr = ci->image_addr;
-    ci->label[ci->label_cnt++].name = strdup("__la64_exec_img_end");
+    /* append binary end label, everything up to it is used once .bss is zeroed */
+    label_add(ci, "__la64_exec_img_end", ci->image_addr + ci->bss_size, NULL);
 
     /* now handling relocations */
     for(uint64_t i = 0; i < ci->rtlb_cnt; i++)
@@ -188,7 +315,32 @@ void la64_compiler_lowlevel(compiler_invocation_t *ci)
             diag_error(ci->rtlb[i].ctlink, "label \"%s\" not found\n", ci->rtlb[i].name);
         }
 
+        /* applying what the expression added to the label */
+        if(ci->rtlb[i].sub != NULL)
+        {
+            uint64_t sub = label_lookup(ci, ci->rtlb[i].sub);
+
+            if(sub == COMPILER_LABEL_NOT_FOUND)
+            {
+                diag_error(ci->rtlb[i].ctlink, "label \"%s\" not found\n", ci->rtlb[i].sub);
+            }
+
+            addr -= sub;
+        }
+
+        addr += ci->rtlb[i].addend;
+
+        /* narrow data entries take the value if it fits either unsigned or signed */
+        int bits = (ci->rtlb[i].bits == 0) ? 64 : ci->rtlb[i].bits;
+
+        if(bits < 64 &&
+           (addr >> bits) != 0 &&
+           ((int64_t)addr >> (bits - 1)) != -1)
+        {
+            diag_error(ci->rtlb[i].ctlink, "value 0x%lx of \"%s\" does not fit in %d bits\n", addr, ci->rtlb[i].ctlink->str, bits);
+        }
+
         /* using da bitwalker to fixup address */
-        bitwalker_write(&(ci->rtlb[i].bw), addr, 64);
+        bitwalker_write(&(ci->rtlb[i].bw), addr, bits);
     }
 }
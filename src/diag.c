@@ -26,11 +26,24 @@
 
 #include <unistd.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
 #include <stdarg.h>
 #include <stdint.h>
 
+/* a batch job captures its diagnostics and unwinds on errors instead of exiting */
+static _Thread_local FILE *diag_stream;
+static _Thread_local jmp_buf *diag_abort;
+static _Thread_local diag_record_t *diag_rec;
+
 static inline int putchar_c(char c)
 {
+    if(diag_stream != NULL)
+    {
+        return (fputc(c, diag_stream) == EOF) ? 0 : 1;
+    }
+
     return write(1, &c, 1);
 }
 
@@ -45,7 +58,7 @@ static inline int putstr_c(char *s)
 
     while(*s)
     {
-        count += write(1, s++, 1);
+        count += putchar_c(*s++);
     }
 
     return count;
@@ -173,6 +186,10 @@ static inline int handle_format(const char *fmt,
                     (*i)++;
                     count += putnbr_base_unsigned(va_arg(*args, unsigned long), "0123456789");
                     break;
+                case 'x':
+                    (*i)++;
+                    count += putnbr_base_unsigned(va_arg(*args, unsigned long), "0123456789abcdef");
+                    break;
                 default:
                     break;
             }
@@ -220,11 +237,11 @@ void diag_note(compiler_token_t *ct,
     /* handling compiler token if passed */
     if(ct != NULL)
     {
-        printf("%s:%zu:%zu: ", ct->cl->ci->file[ct->cl->file_idx].path, ct->cl->line_num, ct->column_num);
+        fprintf(diag_file(stdout), "%s:%zu:%zu: ", ct->cl->ci->file[ct->cl->file_idx].path, ct->cl->line_num, ct->column_num);
     }
 
     /* initial debug print */
-    printf("\033[35mnote:\033[0m ");
+    fprintf(diag_file(stdout), "\033[35mnote:\033[0m ");
 
     /* starting to parse arguments */
     va_list args;
@@ -248,11 +265,11 @@ void diag_warn(compiler_token_t *ct,
     /* handling compiler token if passed */
     if(ct != NULL)
     {
-        printf("%s:%zu:%zu: ", ct->cl->ci->file[ct->cl->file_idx].path, ct->cl->line_num, ct->column_num);
+        fprintf(diag_file(stdout), "%s:%zu:%zu: ", ct->cl->ci->file[ct->cl->file_idx].path, ct->cl->line_num, ct->column_num);
     }
 
     /* initial debug print */
-    printf("\033[33mwarning:\033[0m ");
+    fprintf(diag_file(stdout), "\033[33mwarning:\033[0m ");
 
     /* starting to parse arguments */
     va_list args;
@@ -276,11 +293,18 @@ void diag_error(compiler_token_t *ct,
     /* handling compiler token if passed */
     if(ct != NULL)
     {
-        printf("%s:%zu:%zu: ", ct->cl->ci->file[ct->cl->file_idx].path, ct->cl->line_num, ct->column_num);
+        fprintf(diag_file(stdout), "%s:%zu:%zu: ", ct->cl->ci->file[ct->cl->file_idx].path, ct->cl->line_num, ct->column_num);
     }
 
     /* initial debug print */
-    printf("\033[31merror:\033[0m ");
+    fprintf(diag_file(stdout), "\033[31merror:\033[0m ");
+
+    /* remembering where the error is, its message follows in the stream */
+    if(diag_rec != NULL)
+    {
+        diag_rec->line_num = (ct != NULL) ? ct->cl->line_num : 0;
+        diag_rec->msg_off = ftell(diag_file(stdout));
+    }
 
     /* starting to parse arguments */
     va_list args;
@@ -297,5 +321,38 @@ void diag_error(compiler_token_t *ct,
     va_end(args);
 
     /* a error is a no go */
-    exit(1);
+    diag_exit(1);
+}
+
+void diag_capture(FILE *fp,
+                  jmp_buf *env)
+{
+    diag_stream = fp;
+    diag_abort = env;
+}
+
+void diag_record(diag_record_t *dr)
+{
+    diag_rec = dr;
+}
+
+FILE *diag_file(FILE *fp)
+{
+    return (diag_stream != NULL) ? diag_stream : fp;
+}
+
+void diag_perror(const char *path)
+{
+    fprintf(diag_file(stderr), "%s: %s\n", path, strerror(errno));
+}
+
+void diag_exit(int status)
+{
+    /* unwinding to the job instead of taking the whole batch down */
+    if(diag_abort != NULL)
+    {
+        longjmp(*diag_abort, status);
+    }
+
+    exit(status);
 }
@@ -0,0 +1,604 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2024 cr4zyengineer
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <la64asm/type.h>
+#include <la64asm/opcode.h>
+#include <la64asm/register.h>
+
+#define DIS_CODING_INVALID                      0xFF
+#define DIS_OPERAND_MAX                         32
+#define DIS_ROW_BYTES                           8
+
+typedef struct {
+    char *name;                             /* name of the label */
+    uint64_t addr;                          /* address of the label */
+    char type;                              /* nm style kind, T/t code, D data, B .bss, A absolute */
+} dis_symbol_t;
+
+typedef struct {
+    const uint8_t *image;                   /* mapped image */
+    uint64_t size;                          /* size of the image */
+    dis_symbol_t *sym;                      /* symbols in address order */
+    uint64_t sym_cnt;                       /* count of symbols */
+} dis_t;
+
+typedef struct {
+    uint8_t opcode;                         /* opcode byte */
+    uint8_t operand_cnt;                    /* count of operands */
+    uint8_t coding[DIS_OPERAND_MAX];        /* LA64_PARAMETER_CODING_* of each operand */
+    uint64_t value[DIS_OPERAND_MAX];        /* register or immediate of each operand */
+    uint64_t len;                           /* bytes the instruction takes */
+} dis_instr_t;
+
+/* decode tables, built once out of the tables the assembler encodes with */
+static const char *dis_opcode[256];
+static uint8_t dis_opcode_len[256];
+static const char *dis_register[32];
+static uint8_t dis_register_len[32];
+static char dis_hex_byte[256][2];
+static uint8_t dis_coding_bits[8];
+static bool dis_opcode_bare[256];
+
+static const char dis_hex[] = "0123456789abcdef";
+
+static char dis_buf[1 << 16];
+static size_t dis_buf_len;
+
+static void dis_tables_init(void)
+{
+    for(int i = 0; i <= LA64_OPCODE_MAX; i++)
+    {
+        dis_opcode[opcode_table[i].opcode] = opcode_table[i].name;
+        dis_opcode_len[opcode_table[i].opcode] = strlen(opcode_table[i].name);
+    }
+
+    for(int i = 0; i <= LA64_REGISTER_MAX; i++)
+    {
+        dis_register[register_table[i].reg & 0x1F] = register_table[i].name;
+        dis_register_len[register_table[i].reg & 0x1F] = strlen(register_table[i].name);
+    }
+
+    for(int i = 0; i < 256; i++)
+    {
+        dis_hex_byte[i][0] = dis_hex[i >> 4];
+        dis_hex_byte[i][1] = dis_hex[i & 0xF];
+    }
+
+    /* payload bits following each 3 bit operand coding */
+    memset(dis_coding_bits, DIS_CODING_INVALID, sizeof(dis_coding_bits));
+    dis_coding_bits[LA64_PARAMETER_CODING_INSTR_END] = 0;
+    dis_coding_bits[LA64_PARAMETER_CODING_REG] = 5;
+    dis_coding_bits[LA64_PARAMETER_CODING_IMM8] = 8;
+    dis_coding_bits[LA64_PARAMETER_CODING_IMM16] = 16;
+    dis_coding_bits[LA64_PARAMETER_CODING_IMM32] = 32;
+    dis_coding_bits[LA64_PARAMETER_CODING_IMM64] = 64;
+
+    /* these are a single byte without a operand list */
+    dis_opcode_bare[LA64_OPCODE_HLT] = true;
+    dis_opcode_bare[LA64_OPCODE_NOP] = true;
+    dis_opcode_bare[LA64_OPCODE_RET] = true;
+}
+
+static void dis_flush(void)
+{
+    fwrite(dis_buf, 1, dis_buf_len, stdout);
+    dis_buf_len = 0;
+}
+
+static inline void dis_put(const char *str,
+                           size_t len)
+{
+    if(dis_buf_len + len > sizeof(dis_buf))
+    {
+        dis_flush();
+
+        if(len > sizeof(dis_buf))
+        {
+            fwrite(str, 1, len, stdout);
+            return;
+        }
+    }
+
+    memcpy(&dis_buf[dis_buf_len], str, len);
+    dis_buf_len += len;
+}
+
+static inline void dis_puts(const char *str)
+{
+    dis_put(str, strlen(str));
+}
+
+static inline void dis_put_hex(uint64_t value,
+                               int digits)
+{
+    char tmp[16];
+
+    /* two digits per table lookup */
+    int i = digits;
+    for(; i >= 2; i -= 2)
+    {
+        memcpy(&tmp[i - 2], dis_hex_byte[value & 0xFF], 2);
+        value >>= 8;
+    }
+
+    if(i == 1)
+    {
+        tmp[0] = dis_hex[value & 0xF];
+    }
+
+    dis_put(tmp, digits);
+}
+
+static inline void dis_put_imm(uint64_t value)
+{
+    int digits = 1;
+    while(digits < 16 && (value >> (digits * 4)) != 0)
+    {
+        digits++;
+    }
+
+    dis_put("0x", 2);
+    dis_put_hex(value, digits);
+}
+
+static inline bool dis_bits(dis_t *ds,
+                            uint64_t pos,
+                            unsigned cnt,
+                            uint64_t *value)
+{
+    uint64_t byte = pos >> 3;
+    unsigned shift = pos & 7;
+
+    if(((pos + cnt + 7) >> 3) > ds->size)
+    {
+        return false;
+    }
+
+    /* bits are written least significant first, so a little endian load lines them up */
+    uint64_t lo = 0;
+    uint64_t hi = 0;
+
+    if(byte + 16 <= ds->size)
+    {
+        memcpy(&lo, &(ds->image[byte]), sizeof(lo));
+        memcpy(&hi, &(ds->image[byte + 8]), sizeof(hi));
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+        lo = __builtin_bswap64(lo);
+        hi = __builtin_bswap64(hi);
+#endif
+    }
+    else
+    {
+        for(uint64_t i = 0; i < 16 && byte + i < ds->size; i++)
+        {
+            if(i < 8)
+            {
+                lo |= (uint64_t)ds->image[byte + i] << (i * 8);
+            }
+            else
+            {
+                hi |= (uint64_t)ds->image[byte + i] << ((i - 8) * 8);
+            }
+        }
+    }
+
+    uint64_t v = (shift == 0) ? lo : ((lo >> shift) | (hi << (64 - shift)));
+    *value = (cnt == 64) ? v : (v & ((1ULL << cnt) - 1));
+
+    return true;
+}
+
+static bool dis_decode(dis_t *ds,
+                       uint64_t addr,
+                       dis_instr_t *di)
+{
+    di->opcode = ds->image[addr];
+    di->operand_cnt = 0;
+    di->len = 1;
+
+    if(dis_opcode[di->opcode] == NULL)
+    {
+        return false;
+    }
+
+    if(dis_opcode_bare[di->opcode])
+    {
+        return true;
+    }
+
+    /* operands follow the opcode until a end coding */
+    uint64_t pos = (addr + 1) * 8;
+    for(;;)
+    {
+        uint64_t coding = 0;
+        if(!dis_bits(ds, pos, 3, &coding))
+        {
+            return false;
+        }
+
+        pos += 3;
+
+        if(coding == LA64_PARAMETER_CODING_INSTR_END)
+        {
+            break;
+        }
+
+        uint8_t bits = dis_coding_bits[coding];
+        if(bits == DIS_CODING_INVALID ||
+           di->operand_cnt == DIS_OPERAND_MAX ||
+           !dis_bits(ds, pos, bits, &(di->value[di->operand_cnt])))
+        {
+            return false;
+        }
+
+        if(coding == LA64_PARAMETER_CODING_REG && dis_register[di->value[di->operand_cnt]] == NULL)
+        {
+            return false;
+        }
+
+        di->coding[di->operand_cnt++] = coding;
+        pos += bits;
+    }
+
+    di->len = ((pos + 7) >> 3) - addr;
+    return true;
+}
+
+static dis_symbol_t *dis_symbol_at(dis_t *ds,
+                                   uint64_t addr)
+{
+    /* bisecting to the first symbol at the address */
+    uint64_t lo = 0;
+    uint64_t hi = ds->sym_cnt;
+
+    while(lo < hi)
+    {
+        uint64_t mid = lo + (hi - lo) / 2;
+
+        if(ds->sym[mid].addr < addr)
+        {
+            lo = mid + 1;
+        }
+        else
+        {
+            hi = mid;
+        }
+    }
+
+    return (lo < ds->sym_cnt && ds->sym[lo].addr == addr) ? &(ds->sym[lo]) : NULL;
+}
+
+static void dis_put_bytes(dis_t *ds,
+                          uint64_t addr,
+                          uint64_t len,
+                          bool pad)
+{
+    char row[DIS_ROW_BYTES * 3];
+    memset(row, ' ', sizeof(row));
+
+    len = (len > DIS_ROW_BYTES) ? DIS_ROW_BYTES : len;
+    for(uint64_t i = 0; i < len; i++)
+    {
+        memcpy(&row[i * 3], dis_hex_byte[ds->image[addr + i]], 2);
+    }
+
+    dis_put("  ", 2);
+    dis_put_hex(addr, 16);
+    dis_put(":  ", 3);
+    dis_put(row, pad ? sizeof(row) : (len * 3 - 1));
+
+    if(pad)
+    {
+        dis_put(" ", 1);
+    }
+}
+
+static void dis_put_instr(dis_t *ds,
+                          uint64_t addr,
+                          dis_instr_t *di)
+{
+    dis_put_bytes(ds, addr, di->len, true);
+    dis_put(dis_opcode[di->opcode], dis_opcode_len[di->opcode]);
+
+    for(uint8_t i = 0; i < di->operand_cnt; i++)
+    {
+        dis_put((i == 0) ? " " : ", ", (i == 0) ? 1 : 2);
+
+        if(di->coding[i] == LA64_PARAMETER_CODING_REG)
+        {
+            dis_put(dis_register[di->value[i]], dis_register_len[di->value[i]]);
+        }
+        else
+        {
+            dis_put_imm(di->value[i]);
+        }
+    }
+
+    /* addresses are only ever 64 bit wide immediates */
+    for(uint8_t i = 0; i < di->operand_cnt; i++)
+    {
+        dis_symbol_t *sym = (di->coding[i] == LA64_PARAMETER_CODING_IMM64) ? dis_symbol_at(ds, di->value[i]) : NULL;
+
+        if(sym != NULL)
+        {
+            dis_put("  ; ", 4);
+            dis_puts(sym->name);
+            break;
+        }
+    }
+
+    dis_put("\n", 1);
+
+    /* the rest of long instructions goes on rows of their own */
+    for(uint64_t off = DIS_ROW_BYTES; off < di->len; off += DIS_ROW_BYTES)
+    {
+        dis_put_bytes(ds, addr + off, di->len - off, false);
+        dis_put("\n", 1);
+    }
+}
+
+static void dis_put_data(dis_t *ds,
+                         uint64_t addr,
+                         uint64_t len)
+{
+    dis_put_bytes(ds, addr, len, true);
+    dis_put("db ", 3);
+
+    for(uint64_t i = 0; i < len; i++)
+    {
+        dis_put((i == 0) ? "" : ", ", (i == 0) ? 0 : 2);
+        dis_put("0x", 2);
+        dis_put(dis_hex_byte[ds->image[addr + i]], 2);
+    }
+
+    dis_put("\n", 1);
+}
+
+static bool dis_symbol_places(dis_symbol_t *sym)
+{
+    /* .bss and absolute symbols do not say anything about the image contents */
+    return sym->type == 'T' || sym->type == 't' || sym->type == 'D';
+}
+
+static void dis_image(dis_t *ds)
+{
+    uint64_t entry = 0;
+    uint64_t bss = 0;
+    dis_bits(ds, COMPILER_IMAGE_HEADER_ENTRY * 8, 64, &entry);
+    dis_bits(ds, COMPILER_IMAGE_HEADER_BSS * 8, 64, &bss);
+
+    dis_puts("; entry ");
+    dis_put_imm(entry);
+    dis_puts(", bss ");
+    dis_put_imm(bss);
+    dis_put("\n", 1);
+
+    /* without a map everything is swept as code, with one the symbols say what is what */
+    bool code = (ds->sym_cnt == 0);
+    uint64_t next = 0;
+
+    while(next < ds->sym_cnt && ds->sym[next].addr < COMPILER_IMAGE_HEADER_SIZE)
+    {
+        next++;
+    }
+
+    for(uint64_t addr = COMPILER_IMAGE_HEADER_SIZE; addr < ds->size;)
+    {
+        /* labels at this address switch the kind of what follows */
+        while(next < ds->sym_cnt && ds->sym[next].addr <= addr)
+        {
+            dis_symbol_t *sym = &(ds->sym[next++]);
+
+            if(sym->addr == addr)
+            {
+                dis_put("\n", 1);
+                dis_puts(sym->name);
+                dis_put(":\n", 2);
+            }
+
+            if(dis_symbol_places(sym))
+            {
+                code = (sym->type != 'D');
+            }
+        }
+
+        /* nothing may run past the next label */
+        uint64_t end = ds->size;
+        for(uint64_t n = next; n < ds->sym_cnt; n++)
+        {
+            if(dis_symbol_places(&(ds->sym[n])))
+            {
+                end = (ds->sym[n].addr < end) ? ds->sym[n].addr : end;
+                break;
+            }
+        }
+
+        dis_instr_t di;
+        if(code && dis_decode(ds, addr, &di) && addr + di.len <= end)
+        {
+            dis_put_instr(ds, addr, &di);
+            addr += di.len;
+            continue;
+        }
+
+        /* data and whatever does not decode is dumped as bytes */
+        uint64_t len = code ? 1 : (end - addr);
+        len = (len > DIS_ROW_BYTES) ? DIS_ROW_BYTES : len;
+        dis_put_data(ds, addr, len);
+        addr += len;
+    }
+
+    dis_flush();
+}
+
+static int dis_symbol_compare(const void *a,
+                              const void *b)
+{
+    const dis_symbol_t *sa = a;
+    const dis_symbol_t *sb = b;
+
+    if(sa->addr != sb->addr)
+    {
+        return (sa->addr < sb->addr) ? -1 : 1;
+    }
+
+    return strcmp(sa->name, sb->name);
+}
+
+static void dis_map_load(dis_t *ds,
+                         const char *path)
+{
+    FILE *fp = fopen(path, "r");
+
+    if(fp == NULL)
+    {
+        perror(path);
+        exit(EXIT_FAILURE);
+    }
+
+    /* lines are "address type name" as written by la64asm --map */
+    char *line = NULL;
+    size_t cap = 0;
+    uint64_t num = 0;
+
+    while(getline(&line, &cap, fp) > 0)
+    {
+        num++;
+        line[strcspn(line, "\r\n")] = '\0';
+
+        char *end = NULL;
+        uint64_t addr = strtoull(line, &end, 16);
+
+        if(end == line || end[0] != ' ' || end[1] == '\0' || end[2] != ' ' || end[3] == '\0')
+        {
+            fprintf(stderr, "%s:%llu: malformed map entry\n", path, (unsigned long long)num);
+            exit(EXIT_FAILURE);
+        }
+
+        ds->sym = realloc(ds->sym, (ds->sym_cnt + 1) * sizeof(dis_symbol_t));
+        ds->sym[ds->sym_cnt].addr = addr;
+        ds->sym[ds->sym_cnt].type = end[1];
+        ds->sym[ds->sym_cnt++].name = strdup(&end[3]);
+    }
+
+    free(line);
+    fclose(fp);
+
+    qsort(ds->sym, ds->sym_cnt, sizeof(dis_symbol_t), dis_symbol_compare);
+}
+
+static void usage(const char *name)
+{
+    fprintf(stderr, "Usage: %s [options] <la64 boot image>\n", name);
+    fprintf(stderr, "Options:\n");
+    fprintf(stderr, "  --map=<file>         name addresses using a map written by la64asm --map\n");
+}
+
+int main(int argc, char *argv[])
+{
+    dis_t ds = { 0 };
+    const char *map = NULL;
+    const char *path = NULL;
+
+    /* parsing options */
+    for(int i = 1; i < argc; i++)
+    {
+        if(strncmp(argv[i], "--map=", 6) == 0)
+        {
+            map = argv[i] + 6;
+            continue;
+        }
+
+        if(argv[i][0] == '-' || path != NULL)
+        {
+            usage(argv[0]);
+            return 1;
+        }
+
+        path = argv[i];
+    }
+
+    if(path == NULL)
+    {
+        usage(argv[0]);
+        return 1;
+    }
+
+    /* mapping the image, it is only ever read */
+    int fd = open(path, O_RDONLY);
+    struct stat fdstat;
+
+    if(fd < 0 || fstat(fd, &fdstat) < 0)
+    {
+        perror(path);
+        return 1;
+    }
+
+    if(fdstat.st_size < COMPILER_IMAGE_HEADER_SIZE)
+    {
+        fprintf(stderr, "%s: too small for a la64 boot image\n", path);
+        return 1;
+    }
+
+    ds.size = fdstat.st_size;
+    ds.image = mmap(NULL, ds.size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+
+    if(ds.image == MAP_FAILED)
+    {
+        perror("mmap");
+        return 1;
+    }
+
+    madvise((void*)ds.image, ds.size, MADV_SEQUENTIAL);
+
+    if(map != NULL)
+    {
+        dis_map_load(&ds, map);
+    }
+
+    dis_tables_init();
+    dis_image(&ds);
+
+    /* releasing everything */
+    munmap((void*)ds.image, ds.size);
+
+    for(uint64_t i = 0; i < ds.sym_cnt; i++)
+    {
+        free(ds.sym[i].name);
+    }
+
+    free(ds.sym);
+
+    return 0;
+}
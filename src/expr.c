@@ -0,0 +1,476 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2024 cr4zyengineer
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <la64asm/expr.h>
+#include <la64asm/register.h>
+#include <la64asm/diag.h>
+#include <la64asm/intern.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <lautils/parser.h>
+
+#define EXPR_MAX_DEPTH                          32
+
+typedef struct {
+    compiler_invocation_t *ci;              /* invocation to look up %define% macros in */
+    compiler_token_t *ct;                   /* token to report errors at */
+    const char *scope;                      /* scope local labels are resolved in */
+    const char *p;                          /* current position in the expression */
+    uint64_t depth;                         /* nesting of %define% macros */
+} expr_state_t;
+
+static void expr_or(expr_state_t *es, expr_value_t *ev);
+
+static inline bool expr_is_ident(char c)
+{
+    return isalnum((unsigned char)c) || c == '_' || c == '.';
+}
+
+static inline void expr_skip(expr_state_t *es)
+{
+    while(*es->p == ' ' || *es->p == '\t')
+    {
+        es->p++;
+    }
+}
+
+static void expr_constant(expr_state_t *es,
+                          expr_value_t *ev,
+                          const char *op)
+{
+    if(ev->sym != NULL || ev->sub != NULL)
+    {
+        diag_error(es->ct, "only + and - can be applied to labels, not \"%s\" in \"%s\"\n", op, es->ct->str);
+    }
+}
+
+static void expr_add(expr_state_t *es,
+                     expr_value_t *a,
+                     expr_value_t *b,
+                     bool neg)
+{
+    /* subtracting swaps which label of b is added and which is subtracted */
+    char *bsym = neg ? b->sub : b->sym;
+    char *bsub = neg ? b->sym : b->sub;
+
+    a->value = neg ? a->value - b->value : a->value + b->value;
+
+    if(bsym != NULL)
+    {
+        if(a->sub != NULL && strcmp(a->sub, bsym) == 0)
+        {
+            free(a->sub);
+            free(bsym);
+            a->sub = NULL;
+        }
+        else if(a->sym == NULL)
+        {
+            a->sym = bsym;
+        }
+        else
+        {
+            diag_error(es->ct, "cannot add the labels \"%s\" and \"%s\" in \"%s\"\n", a->sym, bsym, es->ct->str);
+        }
+    }
+
+    if(bsub != NULL)
+    {
+        if(a->sym != NULL && strcmp(a->sym, bsub) == 0)
+        {
+            free(a->sym);
+            free(bsub);
+            a->sym = NULL;
+        }
+        else if(a->sub == NULL)
+        {
+            a->sub = bsub;
+        }
+        else
+        {
+            diag_error(es->ct, "cannot subtract the labels \"%s\" and \"%s\" in \"%s\"\n", a->sub, bsub, es->ct->str);
+        }
+    }
+
+    b->sym = NULL;
+    b->sub = NULL;
+}
+
+static void expr_literal(expr_state_t *es,
+                         expr_value_t *ev,
+                         const char *start)
+{
+    /* the generic parser handles every literal format */
+    char *lit = strndup(start, es->p - start);
+    parser_return_t pr = parse_value_from_string(lit);
+
+    if(pr.type == laParserValueTypeString ||
+       pr.type == laParserValueTypeBuffer)
+    {
+        diag_error(es->ct, "illegal value \"%s\" in \"%s\"\n", lit, es->ct->str);
+    }
+
+    free(lit);
+    ev->value = pr.value;
+}
+
+static void expr_symbol(expr_state_t *es,
+                        expr_value_t *ev,
+                        const char *start)
+{
+    char *name = strndup(start, es->p - start);
+
+    if(register_from_string(name) != NULL)
+    {
+        diag_error(es->ct, "register \"%s\" cannot be used in \"%s\"\n", name, es->ct->str);
+    }
+
+    /* %define% macros are expanded in place, their names are interned */
+    const char *key = intern_find(name);
+
+    for(uint64_t i = 0; key != NULL && i < es->ci->macro_cnt; i++)
+    {
+        compiler_macro_t *cm = &(es->ci->macro[i]);
+
+        if(cm->value != NULL && cm->name == key)
+        {
+            if(es->depth >= EXPR_MAX_DEPTH)
+            {
+                diag_error(es->ct, "%%define%% \"%s\" nested too deep in \"%s\"\n", name, es->ct->str);
+            }
+
+            expr_state_t sub = { .ci = es->ci, .ct = es->ct, .scope = es->scope, .p = cm->value, .depth = es->depth + 1 };
+            expr_or(&sub, ev);
+            expr_skip(&sub);
+
+            if(*sub.p != '\0')
+            {
+                diag_error(es->ct, "unexpected \"%s\" in %%define%% \"%s\"\n", sub.p, name);
+            }
+
+            free(name);
+            return;
+        }
+    }
+
+    /* local labels are resolved in the current scope */
+    if(name[0] == '.' && es->scope != NULL)
+    {
+        char *scoped = NULL;
+        asprintf(&scoped, "%s%s", es->scope, name);
+        free(name);
+        name = scoped;
+    }
+
+    ev->sym = name;
+}
+
+static void expr_primary(expr_state_t *es,
+                         expr_value_t *ev)
+{
+    memset(ev, 0, sizeof(expr_value_t));
+    expr_skip(es);
+
+    const char *start = es->p;
+
+    if(*es->p == '(')
+    {
+        es->p++;
+        expr_or(es, ev);
+        expr_skip(es);
+
+        if(*es->p != ')')
+        {
+            diag_error(es->ct, "missing \")\" in \"%s\"\n", es->ct->str);
+        }
+
+        es->p++;
+    }
+    else if(*es->p == '\'')
+    {
+        /* character literal, escaped quotes stay inside */
+        for(es->p++; *es->p != '\0' && !(*es->p == '\'' && es->p[-1] != '\\'); es->p++);
+
+        if(*es->p == '\0')
+        {
+            diag_error(es->ct, "unterminated character in \"%s\"\n", es->ct->str);
+        }
+
+        es->p++;
+        expr_literal(es, ev, start);
+    }
+    else if(isdigit((unsigned char)*es->p))
+    {
+        while(isalnum((unsigned char)*es->p) || *es->p == '_')
+        {
+            es->p++;
+        }
+
+        expr_literal(es, ev, start);
+    }
+    else if(expr_is_ident(*es->p))
+    {
+        while(expr_is_ident(*es->p))
+        {
+            es->p++;
+        }
+
+        expr_symbol(es, ev, start);
+    }
+    else
+    {
+        diag_error(es->ct, "unexpected \"%s\" in \"%s\"\n", es->p, es->ct->str);
+    }
+}
+
+static void expr_unary(expr_state_t *es,
+                       expr_value_t *ev)
+{
+    expr_skip(es);
+
+    switch(*es->p)
+    {
+        case '-':
+        {
+            es->p++;
+            expr_unary(es, ev);
+
+            /* negating swaps the labels */
+            char *sym = ev->sym;
+            ev->sym = ev->sub;
+            ev->sub = sym;
+            ev->value = -ev->value;
+            break;
+        }
+        case '~':
+            es->p++;
+            expr_unary(es, ev);
+            expr_constant(es, ev, "~");
+            ev->value = ~ev->value;
+            break;
+        case '+':
+            es->p++;
+            expr_unary(es, ev);
+            break;
+        default:
+            expr_primary(es, ev);
+            break;
+    }
+}
+
+static void expr_mul(expr_state_t *es,
+                     expr_value_t *ev)
+{
+    expr_unary(es, ev);
+
+    for(expr_skip(es); *es->p == '*' || *es->p == '/' || *es->p == '%'; expr_skip(es))
+    {
+        char op = *(es->p++);
+        char ops[2] = { op, '\0' };
+        expr_value_t rhs;
+        expr_unary(es, &rhs);
+
+        expr_constant(es, ev, ops);
+        expr_constant(es, &rhs, ops);
+
+        if(op != '*' && rhs.value == 0)
+        {
+            diag_error(es->ct, "division by zero in \"%s\"\n", es->ct->str);
+        }
+
+        ev->value = (op == '*') ? ev->value * rhs.value : (op == '/') ? ev->value / rhs.value : ev->value % rhs.value;
+    }
+}
+
+static void expr_addsub(expr_state_t *es,
+                        expr_value_t *ev)
+{
+    expr_mul(es, ev);
+
+    for(expr_skip(es); *es->p == '+' || *es->p == '-'; expr_skip(es))
+    {
+        bool neg = *(es->p++) == '-';
+        expr_value_t rhs;
+        expr_mul(es, &rhs);
+        expr_add(es, ev, &rhs, neg);
+    }
+}
+
+static void expr_shift(expr_state_t *es,
+                       expr_value_t *ev)
+{
+    expr_addsub(es, ev);
+
+    for(expr_skip(es); (es->p[0] == '<' && es->p[1] == '<') || (es->p[0] == '>' && es->p[1] == '>'); expr_skip(es))
+    {
+        bool left = es->p[0] == '<';
+        es->p += 2;
+
+        expr_value_t rhs;
+        expr_addsub(es, &rhs);
+
+        expr_constant(es, ev, left ? "<<" : ">>");
+        expr_constant(es, &rhs, left ? "<<" : ">>");
+
+        /* shifting by the width or more is undefined in c, but zero is what anyone expects */
+        if(rhs.value >= 64)
+        {
+            ev->value = 0;
+        }
+        else
+        {
+            ev->value = left ? ev->value << rhs.value : ev->value >> rhs.value;
+        }
+    }
+}
+
+static void expr_bitwise(expr_state_t *es,
+                         expr_value_t *ev,
+                         char op)
+{
+    /* precedence climbing from & over ^ to | */
+    switch(op)
+    {
+        case '|':
+            expr_bitwise(es, ev, '^');
+            break;
+        case '^':
+            expr_bitwise(es, ev, '&');
+            break;
+        default:
+            expr_shift(es, ev);
+            break;
+    }
+
+    for(expr_skip(es); *es->p == op; expr_skip(es))
+    {
+        char ops[2] = { op, '\0' };
+        es->p++;
+
+        expr_value_t rhs;
+        switch(op)
+        {
+            case '|':
+                expr_bitwise(es, &rhs, '^');
+                break;
+            case '^':
+                expr_bitwise(es, &rhs, '&');
+                break;
+            default:
+                expr_shift(es, &rhs);
+                break;
+        }
+
+        expr_constant(es, ev, ops);
+        expr_constant(es, &rhs, ops);
+
+        ev->value = (op == '|') ? ev->value | rhs.value : (op == '^') ? ev->value ^ rhs.value : ev->value & rhs.value;
+    }
+}
+
+static void expr_or(expr_state_t *es,
+                    expr_value_t *ev)
+{
+    expr_bitwise(es, ev, '|');
+}
+
+bool expr_is_expression(const char *str)
+{
+    /* strings and characters are left to the generic parser */
+    if(str[0] == '"' || str[0] == '\'')
+    {
+        return false;
+    }
+
+    return strpbrk(str, "+-*/%&|^~()<>") != NULL;
+}
+
+void expr_eval(compiler_invocation_t *ci,
+               compiler_token_t *ct,
+               const char *scope,
+               expr_value_t *ev)
+{
+    expr_state_t es = { .ci = ci, .ct = ct, .scope = scope, .p = ct->str, .depth = 0 };
+
+    expr_or(&es, ev);
+    expr_skip(&es);
+
+    if(*es.p != '\0')
+    {
+        diag_error(ct, "unexpected \"%s\" in \"%s\"\n", es.p, ct->str);
+    }
+
+    if(ev->sym == NULL && ev->sub != NULL)
+    {
+        diag_error(ct, "label \"%s\" can only be subtracted from another label in \"%s\"\n", ev->sub, ct->str);
+    }
+}
+
+uint64_t expr_eval_constant(compiler_invocation_t *ci,
+                            compiler_token_t *ct)
+{
+    expr_value_t ev = { 0 };
+    expr_eval(ci, ct, NULL, &ev);
+
+    if(ev.sym != NULL)
+    {
+        diag_error(ct, "\"%s\" must be a constant\n", ct->str);
+    }
+
+    return ev.value;
+}
+
+void expr_symbols(const char *str,
+                  expr_symbol_fn fn,
+                  void *ctx)
+{
+    /* reporting every identifier that is not part of a literal */
+    for(const char *p = str; *p != '\0';)
+    {
+        if(*p == '\'' || *p == '"')
+        {
+            char q = *(p++);
+            for(; *p != '\0' && !(*p == q && p[-1] != '\\'); p++);
+            p += (*p != '\0');
+        }
+        else if(isdigit((unsigned char)*p))
+        {
+            for(; isalnum((unsigned char)*p) || *p == '_'; p++);
+        }
+        else if(expr_is_ident(*p))
+        {
+            const char *start = p;
+            for(; expr_is_ident(*p); p++);
+
+            char *name = strndup(start, p - start);
+            fn(name, ctx);
+            free(name);
+        }
+        else
+        {
+            p++;
+        }
+    }
+}
@@ -0,0 +1,229 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2024 cr4zyengineer
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <la64asm/flow.h>
+#include <la64asm/opcode.h>
+#include <la64asm/register.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+static int flow_label_compare(const void *a,
+                              const void *b)
+{
+    return strcmp(((const flow_label_t*)a)->name, ((const flow_label_t*)b)->name);
+}
+
+void flow_build(compiler_invocation_t *ci,
+                flow_t *fl)
+{
+    /* counting labels */
+    fl->label_cnt = 0;
+    for(uint64_t i = 0; i < ci->line_cnt; i++)
+    {
+        if(ci->line[i].type == COMPILER_LINE_TYPE_GLOBAL_LABEL ||
+           ci->line[i].type == COMPILER_LINE_TYPE_LOCAL_LABEL)
+        {
+            fl->label_cnt++;
+        }
+    }
+
+    /* allocating memory for those */
+    fl->label = calloc(fl->label_cnt, sizeof(flow_label_t));
+    fl->scope = calloc(ci->line_cnt, sizeof(const char*));
+
+    /* collecting labels and tracking the scope each line lives in */
+    const char *scope = NULL;
+    fl->label_cnt = 0;
+    for(uint64_t i = 0; i < ci->line_cnt; i++)
+    {
+        compiler_line_t *cl = &(ci->line[i]);
+
+        if(cl->type == COMPILER_LINE_TYPE_GLOBAL_LABEL ||
+           cl->type == COMPILER_LINE_TYPE_LOCAL_LABEL)
+        {
+            /* stripping the ':' */
+            char *name = strdup(cl->token[0].str);
+            name[strlen(name) - 1] = '\0';
+
+            if(cl->type == COMPILER_LINE_TYPE_GLOBAL_LABEL)
+            {
+                scope = name;
+            }
+            else if(scope != NULL)
+            {
+                char *scoped = NULL;
+                asprintf(&scoped, "%s%s", scope, name);
+                free(name);
+                name = scoped;
+            }
+
+            fl->label[fl->label_cnt].name = name;
+            fl->label[fl->label_cnt++].line = i;
+        }
+
+        fl->scope[i] = scope;
+    }
+
+    /* sorting them so lookups can bisect */
+    qsort(fl->label, fl->label_cnt, sizeof(flow_label_t), flow_label_compare);
+}
+
+void flow_free(flow_t *fl)
+{
+    for(uint64_t i = 0; i < fl->label_cnt; i++)
+    {
+        free(fl->label[i].name);
+    }
+
+    free(fl->label);
+    free(fl->scope);
+}
+
+void flow_release(void *fl)
+{
+    flow_free(fl);
+    free(fl);
+}
+
+char *flow_label_name(flow_t *fl,
+                      uint64_t line,
+                      const char *str)
+{
+    /* local labels are resolved relative to the scope of the line that references them */
+    char *name = NULL;
+    if(str[0] == '.' && fl->scope[line] != NULL)
+    {
+        asprintf(&name, "%s%s", fl->scope[line], str);
+    }
+    else
+    {
+        name = strdup(str);
+    }
+
+    return name;
+}
+
+uint64_t flow_label_line(flow_t *fl,
+                         const char *name)
+{
+    flow_label_t key = { .name = (char*)name };
+    flow_label_t *label = bsearch(&key, fl->label, fl->label_cnt, sizeof(flow_label_t), flow_label_compare);
+    return (label == NULL) ? FLOW_LINE_NOT_FOUND : label->line;
+}
+
+uint64_t flow_next_asm(compiler_invocation_t *ci,
+                       uint64_t line)
+{
+    /* lines of other sections end up somewhere else in the image */
+    for(uint64_t i = line + 1; i < ci->line_cnt; i++)
+    {
+        if(ci->line[i].type == COMPILER_LINE_TYPE_ASM &&
+           ci->line[i].section == ci->line[line].section)
+        {
+            return i;
+        }
+    }
+
+    return FLOW_LINE_NOT_FOUND;
+}
+
+int flow_line_opcode(compiler_line_t *cl)
+{
+    if(cl->type != COMPILER_LINE_TYPE_ASM ||
+       cl->token_cnt == 0)
+    {
+        return -1;
+    }
+
+    opcode_entry_t *opce = opcode_from_string(cl->token[0].str);
+    return (opce == NULL) ? -1 : opce->opcode;
+}
+
+bool flow_line_is_branch(compiler_line_t *cl)
+{
+    switch(flow_line_opcode(cl))
+    {
+        case LA64_OPCODE_JMP:
+        case LA64_OPCODE_JE:
+        case LA64_OPCODE_JNE:
+        case LA64_OPCODE_JLT:
+        case LA64_OPCODE_JGT:
+        case LA64_OPCODE_JLE:
+        case LA64_OPCODE_JGE:
+        case LA64_OPCODE_JZ:
+        case LA64_OPCODE_JNZ:
+            return true;
+        default:
+            return false;
+    }
+}
+
+bool flow_line_ends_block(compiler_line_t *cl)
+{
+    switch(flow_line_opcode(cl))
+    {
+        case LA64_OPCODE_HLT:
+        case LA64_OPCODE_JMP:
+        case LA64_OPCODE_RET:
+            return true;
+        default:
+            return false;
+    }
+}
+
+bool flow_token_is_label(compiler_token_t *ct)
+{
+    const char *str = ct->str;
+
+    /* labels are identifiers, everything else is a value or a register */
+    if(str[0] == '\0' || isdigit((unsigned char)str[0]))
+    {
+        return false;
+    }
+
+    for(const char *p = str; *p != '\0'; p++)
+    {
+        if(!isalnum((unsigned char)*p) && *p != '_' && *p != '.')
+        {
+            return false;
+        }
+    }
+
+    return register_from_string(str) == NULL;
+}
+
+compiler_token_t *flow_line_target(compiler_line_t *cl)
+{
+    /* the destination of a branch or call is its last operand */
+    if(cl->token_cnt < 2 ||
+       (!flow_line_is_branch(cl) && flow_line_opcode(cl) != LA64_OPCODE_BL))
+    {
+        return NULL;
+    }
+
+    compiler_token_t *ct = &(cl->token[cl->token_cnt - 1]);
+    return flow_token_is_label(ct) ? ct : NULL;
+}
@@ -0,0 +1,714 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2024 cr4zyengineer
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <la64asm/index.h>
+#include <la64asm/code.h>
+#include <la64asm/compile.h>
+#include <la64asm/diag.h>
+#include <la64asm/expr.h>
+#include <la64asm/flow.h>
+#include <la64asm/intern.h>
+#include <la64asm/opcode.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <setjmp.h>
+#include <ftw.h>
+
+#define INDEX_DEF_MIN                           0x400
+
+typedef struct {
+    index_t *ix;                            /* index the document belongs to */
+    index_doc_t *doc;                       /* document being indexed */
+    const char *code;                       /* text of the document */
+    uint32_t *start;                        /* offset of every line in the text */
+    uint32_t line_cnt;                      /* count of lines */
+    index_symbol_t *sym;                    /* symbols found so far */
+    uint64_t sym_cnt;                       /* count of symbols */
+    const char *scope;                      /* global label local labels belong to, interned */
+    compiler_line_t *macro;                 /* %macro% line whose body is being indexed, NULL if none */
+    uint32_t line;                          /* zero based line being indexed */
+    uint32_t cursor;                        /* column the next token is searched from */
+    uint32_t token_cursor;                  /* column the next expression symbol is searched from */
+} index_builder_t;
+
+static _Thread_local index_t *index_walk_ctx;
+
+static index_def_t *index_def_slot(index_t *ix,
+                                   const char *name)
+{
+    uint64_t mask = ix->def_size - 1;
+
+    for(uint64_t i = intern_hash(name) & mask;; i = (i + 1) & mask)
+    {
+        if(ix->def[i].name == NULL || ix->def[i].name == name)
+        {
+            return &(ix->def[i]);
+        }
+    }
+}
+
+static void index_def_adjust(index_t *ix,
+                             const char *name,
+                             int64_t by)
+{
+    /* names stay once seen, there are only ever as many as identifiers in the code base */
+    if((ix->def_used + 1) * 2 > ix->def_size)
+    {
+        index_def_t *old = ix->def;
+        uint64_t old_size = ix->def_size;
+
+        ix->def_size = (old_size == 0) ? INDEX_DEF_MIN : old_size * 2;
+        ix->def = calloc(ix->def_size, sizeof(index_def_t));
+
+        for(uint64_t i = 0; i < old_size; i++)
+        {
+            if(old[i].name != NULL)
+            {
+                *index_def_slot(ix, old[i].name) = old[i];
+            }
+        }
+
+        free(old);
+    }
+
+    index_def_t *def = index_def_slot(ix, name);
+
+    if(def->name == NULL)
+    {
+        def->name = name;
+        ix->def_used++;
+    }
+
+    def->def_cnt += by;
+}
+
+uint64_t index_def_count(index_t *ix,
+                         const char *name)
+{
+    return (ix->def_size == 0) ? 0 : index_def_slot(ix, name)->def_cnt;
+}
+
+static uint32_t index_find(index_builder_t *ib,
+                           uint32_t from,
+                           const char *str,
+                           size_t len)
+{
+    /* tokens are pieces of the line, so they are found again in order */
+    const char *line = &(ib->code[ib->start[ib->line]]);
+    const char *eol = strchr(line, '\n');
+    size_t line_len = (eol == NULL) ? strlen(line) : (size_t)(eol - line);
+
+    if(from > line_len)
+    {
+        return from;
+    }
+
+    const char *hit = memmem(line + from, line_len - from, str, len);
+    return (hit == NULL) ? from : (uint32_t)(hit - line);
+}
+
+static void index_symbol(index_builder_t *ib,
+                         const char *name,
+                         uint32_t col,
+                         uint32_t len,
+                         uint8_t kind,
+                         uint8_t flags)
+{
+    if((ib->sym_cnt & (ib->sym_cnt - 1)) == 0)
+    {
+        ib->sym = realloc(ib->sym, ((ib->sym_cnt == 0) ? 1 : ib->sym_cnt * 2) * sizeof(index_symbol_t));
+    }
+
+    flags |= (ib->macro != NULL) ? INDEX_FLAG_BODY : 0;
+    ib->sym[ib->sym_cnt++] = (index_symbol_t){ .name = name, .line = ib->line, .col = col, .len = len, .kind = kind, .flags = flags };
+}
+
+static uint32_t index_token(index_builder_t *ib,
+                            compiler_token_t *ct)
+{
+    /* column of the token, later tokens are searched behind it */
+    size_t len = strlen(ct->str);
+    uint32_t col = index_find(ib, ib->cursor, ct->str, len);
+    ib->cursor = col + len;
+    return col;
+}
+
+static const char *index_qualify(index_builder_t *ib,
+                                 const char *name,
+                                 size_t len)
+{
+    /* local labels are known by their global label */
+    const char *str = intern_n(name, len);
+    return (name[0] == '.' && ib->scope != NULL) ? intern_cat(ib->scope, str) : str;
+}
+
+static bool index_is_param(index_builder_t *ib,
+                           const char *name)
+{
+    for(uint64_t p = 2; ib->macro != NULL && p < ib->macro->token_cnt; p++)
+    {
+        if(strcmp(ib->macro->token[p].str, name) == 0)
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static void index_expr_symbol(const char *name,
+                              void *ctx)
+{
+    index_builder_t *ib = ctx;
+    size_t len = strlen(name);
+    uint32_t col = index_find(ib, ib->token_cursor, name, len);
+    ib->token_cursor = col + len;
+
+    if(!index_is_param(ib, name))
+    {
+        index_symbol(ib, index_qualify(ib, name, len), col, len, INDEX_SYMBOL_REF, 0);
+    }
+}
+
+static void index_refs(index_builder_t *ib,
+                       compiler_line_t *cl,
+                       uint64_t first)
+{
+    for(uint64_t i = first; i < cl->token_cnt; i++)
+    {
+        compiler_token_t *ct = &(cl->token[i]);
+        uint32_t col = index_token(ib, ct);
+
+        if(expr_is_expression(ct->str))
+        {
+            ib->token_cursor = col;
+            expr_symbols(ct->str, index_expr_symbol, ib);
+        }
+        else if(flow_token_is_label(ct) && !index_is_param(ib, ct->str))
+        {
+            size_t len = strlen(ct->str);
+            index_symbol(ib, index_qualify(ib, ct->str, len), col, len, INDEX_SYMBOL_REF, 0);
+        }
+    }
+}
+
+static void index_include(index_builder_t *ib,
+                          compiler_line_t *cl)
+{
+    if(cl->token_cnt < 2)
+    {
+        return;
+    }
+
+    /* resolved the way the assembler resolves it, relative to the including file first */
+    compiler_token_t *ct = &(cl->token[1]);
+    size_t len = strlen(ct->str);
+    uint32_t col = index_token(ib, ct);
+
+    if(len < 2 || ct->str[0] != '"' || ct->str[len - 1] != '"')
+    {
+        return;
+    }
+
+    char *path = code_include_path(ib->doc->path, ct->str + 1, len - 2);
+    char *real = realpath(path, NULL);
+
+    if(real != NULL)
+    {
+        index_symbol(ib, intern(real), col + 1, len - 2, INDEX_SYMBOL_INCLUDE, 0);
+    }
+
+    free(real);
+    free(path);
+}
+
+static void index_line(index_builder_t *ib,
+                       compiler_line_t *cl)
+{
+    if(cl->token_cnt == 0)
+    {
+        return;
+    }
+
+    ib->line = cl->line_num - 1;
+    ib->cursor = 0;
+
+    compiler_token_t *head = &(cl->token[0]);
+    size_t len = strlen(head->str);
+
+    switch(cl->type)
+    {
+        case COMPILER_LINE_TYPE_GLOBAL_LABEL:
+        {
+            const char *name = intern_n(head->str, len - 1);
+            index_symbol(ib, name, index_token(ib, head), len - 1, INDEX_SYMBOL_LABEL, INDEX_FLAG_DEF);
+            ib->scope = name;
+            break;
+        }
+        case COMPILER_LINE_TYPE_LOCAL_LABEL:
+            index_symbol(ib, index_qualify(ib, head->str, len - 1), index_token(ib, head), len - 1, INDEX_SYMBOL_LABEL, INDEX_FLAG_DEF);
+            break;
+        case COMPILER_LINE_TYPE_SECTION:
+            index_token(ib, head);
+
+            /* a section is defined everywhere it is opened */
+            if(cl->token_cnt > 1)
+            {
+                index_symbol(ib, intern(cl->token[1].str), index_token(ib, &(cl->token[1])), strlen(cl->token[1].str), INDEX_SYMBOL_SECTION, INDEX_FLAG_DEF);
+            }
+            break;
+        case COMPILER_LINE_TYPE_SECTION_DATA:
+            if(head->str[0] != '.')
+            {
+                index_symbol(ib, intern(head->str), index_token(ib, head), len, INDEX_SYMBOL_DATA, INDEX_FLAG_DEF);
+
+                /* the entry type sits between the name and the values */
+                if(cl->token_cnt > 1)
+                {
+                    index_token(ib, &(cl->token[1]));
+                }
+
+                index_refs(ib, cl, 2);
+            }
+            break;
+        case COMPILER_LINE_TYPE_MACRODEF:
+            index_token(ib, head);
+
+            if(cl->token_cnt > 1)
+            {
+                index_symbol(ib, intern(cl->token[1].str), index_token(ib, &(cl->token[1])), strlen(cl->token[1].str), INDEX_SYMBOL_DEFINE, INDEX_FLAG_DEF);
+            }
+            break;
+        case COMPILER_LINE_TYPE_MACROBEGIN:
+            index_token(ib, head);
+
+            if(cl->token_cnt > 1)
+            {
+                index_symbol(ib, intern(cl->token[1].str), index_token(ib, &(cl->token[1])), strlen(cl->token[1].str), INDEX_SYMBOL_MACRO, INDEX_FLAG_DEF);
+            }
+
+            ib->macro = cl;
+            break;
+        case COMPILER_LINE_TYPE_MACROEND:
+            ib->macro = NULL;
+            break;
+        case COMPILER_LINE_TYPE_INCLUDE:
+            index_token(ib, head);
+            index_include(ib, cl);
+            break;
+        case COMPILER_LINE_TYPE_EXPORT:
+        case COMPILER_LINE_TYPE_REPT:
+            index_token(ib, head);
+            index_refs(ib, cl, 1);
+            break;
+        case COMPILER_LINE_TYPE_ASM:
+        {
+            uint32_t col = index_token(ib, head);
+
+            /* anything in front that is not an instruction has to be a macro */
+            if(strcmp(head->str, ".align") != 0 &&
+               strcmp(head->str, ".balign") != 0 &&
+               opcode_from_string(head->str) == NULL &&
+               !index_is_param(ib, head->str))
+            {
+                index_symbol(ib, intern(head->str), col, len, INDEX_SYMBOL_REF, INDEX_FLAG_HEAD);
+            }
+
+            index_refs(ib, cl, 1);
+            break;
+        }
+        default:
+            break;
+    }
+}
+
+static void index_defs(index_t *ix,
+                       index_doc_t *doc,
+                       int64_t by)
+{
+    for(uint64_t i = 0; i < doc->sym_cnt; i++)
+    {
+        if(doc->sym[i].flags & INDEX_FLAG_DEF)
+        {
+            index_def_adjust(ix, doc->sym[i].name, by);
+        }
+    }
+}
+
+void index_update(index_t *ix,
+                  index_doc_t *doc,
+                  const char *text,
+                  size_t len)
+{
+    /* the document is tokenized on its own, like the assembler would if it were the only input */
+    static const compiler_options_t opt = { .flags = COMPILER_FLAG_NONE, .output = "a.out" };
+    compiler_invocation_t *ci = compiler_invocation_alloc(&opt);
+
+    char *code = malloc(len + 2);
+    memcpy(code, text, len);
+    code[len] = '\n';
+    code[len + 1] = '\0';
+
+    /* windows line endings would stick to the last token, a space keeps the columns */
+    uint32_t line_cnt = 1;
+    for(size_t i = 0; i < len; i++)
+    {
+        code[i] = (code[i] == '\r') ? ' ' : code[i];
+        line_cnt += (code[i] == '\n');
+    }
+
+    uint32_t *start = calloc(line_cnt, sizeof(uint32_t));
+    for(size_t i = 0, l = 1; i < len; i++)
+    {
+        if(code[i] == '\n')
+        {
+            start[l++] = i + 1;
+        }
+    }
+
+    ci->file = calloc(1, sizeof(compiler_file_t));
+    ci->file[0].path = strdup(doc->path);
+    ci->file[0].code = code;
+    ci->file[0].len = len + 1;
+    ci->file_cnt = 1;
+
+    /* errors only end the tokenization, the message is kept for the editor */
+    char *out = NULL;
+    size_t out_len = 0;
+    FILE *fp = open_memstream(&out, &out_len);
+    diag_record_t dr = { 0 };
+    jmp_buf env;
+    int status = setjmp(env);
+
+    if(status == 0)
+    {
+        diag_capture(fp, &env);
+        diag_record(&dr);
+        code_tokengen(ci);
+    }
+
+    diag_record(NULL);
+    diag_capture(NULL, NULL);
+    fclose(fp);
+
+    free(doc->error);
+    doc->error = NULL;
+
+    if(status != 0)
+    {
+        /* keeping the symbols known so far, positions may be off until the error is fixed */
+        doc->error = strdup((dr.msg_off >= 0 && (size_t)dr.msg_off < out_len) ? &(out[dr.msg_off]) : "tokenization failed");
+        doc->error[strcspn(doc->error, "\n")] = '\0';
+        doc->error_line = (dr.line_num > 0) ? dr.line_num - 1 : 0;
+    }
+    else
+    {
+        index_builder_t ib = { .ix = ix, .doc = doc, .code = code, .start = start, .line_cnt = line_cnt };
+
+        for(uint64_t i = 0; i < ci->line_cnt; i++)
+        {
+            index_line(&ib, &(ci->line[i]));
+        }
+
+        /* swapping the symbols, the definition counts follow */
+        index_defs(ix, doc, -1);
+        free(doc->sym);
+        doc->sym = ib.sym;
+        doc->sym_cnt = ib.sym_cnt;
+        index_defs(ix, doc, 1);
+    }
+
+    free(out);
+    free(start);
+    compiler_invocation_dealloc(ci);
+
+    /* included files are part of the code base even if nothing else found them */
+    for(uint64_t i = 0; i < doc->sym_cnt; i++)
+    {
+        if(doc->sym[i].kind == INDEX_SYMBOL_INCLUDE && index_doc(ix, doc->sym[i].name) == NULL)
+        {
+            index_add(ix, doc->sym[i].name);
+        }
+    }
+}
+
+bool index_reload(index_t *ix,
+                  index_doc_t *doc)
+{
+    FILE *fp = fopen(doc->path, "rb");
+
+    if(fp == NULL)
+    {
+        return false;
+    }
+
+    char *text = NULL;
+    size_t len = 0;
+    size_t cap = 0;
+    size_t got = 0;
+
+    do
+    {
+        if(len == cap)
+        {
+            cap = (cap == 0) ? 0x1000 : cap * 2;
+            text = realloc(text, cap);
+        }
+
+        got = fread(&(text[len]), 1, cap - len, fp);
+        len += got;
+    }
+    while(got > 0);
+
+    fclose(fp);
+    index_update(ix, doc, text, len);
+    free(text);
+
+    return true;
+}
+
+index_doc_t *index_doc(index_t *ix,
+                       const char *path)
+{
+    for(uint64_t i = 0; i < ix->doc_cnt; i++)
+    {
+        if(strcmp(ix->doc[i]->path, path) == 0)
+        {
+            return ix->doc[i];
+        }
+    }
+
+    return NULL;
+}
+
+index_doc_t *index_add(index_t *ix,
+                       const char *path)
+{
+    /* canonical, so includes and the editor agree on what a file is, new files keep their path */
+    char *real = realpath(path, NULL);
+    index_doc_t *doc = index_doc(ix, (real != NULL) ? real : path);
+
+    if(doc != NULL)
+    {
+        free(real);
+        return doc;
+    }
+
+    doc = calloc(1, sizeof(index_doc_t));
+    doc->path = (real != NULL) ? real : strdup(path);
+
+    ix->doc = realloc(ix->doc, (ix->doc_cnt + 1) * sizeof(index_doc_t*));
+    ix->doc[ix->doc_cnt++] = doc;
+
+    index_reload(ix, doc);
+    return doc;
+}
+
+void index_remove(index_t *ix,
+                  index_doc_t *doc)
+{
+    index_defs(ix, doc, -1);
+
+    for(uint64_t i = 0; i < ix->doc_cnt; i++)
+    {
+        if(ix->doc[i] == doc)
+        {
+            ix->doc[i] = ix->doc[--ix->doc_cnt];
+            break;
+        }
+    }
+
+    free(doc->path);
+    free(doc->text);
+    free(doc->sym);
+    free(doc->error);
+    free(doc);
+}
+
+static int index_walk(const char *path,
+                      const struct stat *st,
+                      int flag,
+                      struct FTW *ftw)
+{
+    const char *base = path + ftw->base;
+    (void)st;
+
+    /* hidden directories are version control and editor state */
+    if(flag == FTW_D && ftw->level > 0 && base[0] == '.')
+    {
+        return FTW_SKIP_SUBTREE;
+    }
+
+    const char *ext = strrchr(base, '.');
+
+    if(flag == FTW_F && ext != NULL &&
+       (strcmp(ext, ".s") == 0 || strcmp(ext, ".S") == 0 || strcmp(ext, ".asm") == 0 || strcmp(ext, ".inc") == 0))
+    {
+        index_add(index_walk_ctx, path);
+    }
+
+    return FTW_CONTINUE;
+}
+
+void index_workspace(index_t *ix,
+                     const char *root)
+{
+    index_walk_ctx = ix;
+    nftw(root, index_walk, 32, FTW_PHYS | FTW_ACTIONRETVAL);
+    index_walk_ctx = NULL;
+}
+
+index_symbol_t *index_symbol_at(index_doc_t *doc,
+                                uint32_t line,
+                                uint32_t col)
+{
+    /* symbols are in line order */
+    uint64_t lo = 0;
+    uint64_t hi = doc->sym_cnt;
+
+    while(lo < hi)
+    {
+        uint64_t mid = (lo + hi) / 2;
+
+        if(doc->sym[mid].line < line)
+        {
+            lo = mid + 1;
+        }
+        else
+        {
+            hi = mid;
+        }
+    }
+
+    for(; lo < doc->sym_cnt && doc->sym[lo].line == line; lo++)
+    {
+        if(col >= doc->sym[lo].col && col <= doc->sym[lo].col + doc->sym[lo].len)
+        {
+            return &(doc->sym[lo]);
+        }
+    }
+
+    return NULL;
+}
+
+static int index_sym_compare(const void *a,
+                             const void *b)
+{
+    const index_symbol_t *sa = *(index_symbol_t* const*)a;
+    const index_symbol_t *sb = *(index_symbol_t* const*)b;
+
+    if(sa->name != sb->name)
+    {
+        return (sa->name < sb->name) ? -1 : 1;
+    }
+
+    return (sa < sb) ? -1 : (sa > sb);
+}
+
+static void index_diag(index_diag_t **diag,
+                       uint64_t *diag_cnt,
+                       index_symbol_t *sym,
+                       const char *fmt,
+                       const char *name)
+{
+    *diag = realloc(*diag, (*diag_cnt + 1) * sizeof(index_diag_t));
+    index_diag_t *id = &((*diag)[(*diag_cnt)++]);
+
+    id->line = sym->line;
+    id->col = sym->col;
+    id->len = sym->len;
+    asprintf(&(id->msg), fmt, name);
+}
+
+uint64_t index_diagnose(index_t *ix,
+                        index_doc_t *doc,
+                        index_diag_t **diag)
+{
+    uint64_t diag_cnt = 0;
+    *diag = NULL;
+
+    if(doc->error != NULL)
+    {
+        *diag = calloc(1, sizeof(index_diag_t));
+        (*diag)[0].line = doc->error_line;
+        (*diag)[0].msg = strdup(doc->error);
+        diag_cnt++;
+    }
+
+    /* duplicates are only certain inside a document, other files might belong to other programs */
+    index_symbol_t **label = calloc(doc->sym_cnt, sizeof(index_symbol_t*));
+    uint64_t label_cnt = 0;
+
+    for(uint64_t i = 0; i < doc->sym_cnt; i++)
+    {
+        index_symbol_t *sym = &(doc->sym[i]);
+
+        if((sym->flags & (INDEX_FLAG_DEF | INDEX_FLAG_BODY)) == INDEX_FLAG_DEF &&
+           (sym->kind == INDEX_SYMBOL_LABEL || sym->kind == INDEX_SYMBOL_DATA))
+        {
+            label[label_cnt++] = sym;
+        }
+
+        /* macro bodies only make sense where they are expanded */
+        if(sym->kind != INDEX_SYMBOL_REF || (sym->flags & INDEX_FLAG_BODY) ||
+           index_def_count(ix, sym->name) > 0 || strcmp(sym->name, "__la64_exec_img_end") == 0)
+        {
+            continue;
+        }
+
+        if(sym->flags & INDEX_FLAG_HEAD)
+        {
+            index_diag(diag, &diag_cnt, sym, "illegal opcode \"%s\"", sym->name);
+        }
+        else
+        {
+            index_diag(diag, &diag_cnt, sym, "label \"%s\" not found", sym->name);
+        }
+    }
+
+    qsort(label, label_cnt, sizeof(index_symbol_t*), index_sym_compare);
+
+    for(uint64_t i = 1; i < label_cnt; i++)
+    {
+        if(label[i]->name == label[i - 1]->name)
+        {
+            index_diag(diag, &diag_cnt, label[i], "duplicated label \"%s\"", label[i]->name);
+        }
+    }
+
+    free(label);
+    return diag_cnt;
+}
+
+void index_free(index_t *ix)
+{
+    while(ix->doc_cnt > 0)
+    {
+        index_remove(ix, ix->doc[0]);
+    }
+
+    free(ix->doc);
+    free(ix->def);
+}
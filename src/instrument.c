@@ -0,0 +1,216 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2024 cr4zyengineer
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <la64asm/instrument.h>
+#include <la64asm/flow.h>
+#include <la64asm/code.h>
+#include <la64asm/diag.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+
+/* lines put in front of every block, %s is the address of its counter */
+static const char *instrument_sequence[][3] = {
+    { "push", "r0", NULL },
+    { "push", "r1", NULL },
+    { "push", "cf", NULL },
+    { "mov", "r0", "%s" },
+    { "ldq", "r1", "r0" },
+    { "inc", "r1", NULL },
+    { "stq", "r0", "r1" },
+    { "pop", "cf", NULL },
+    { "pop", "r1", NULL },
+    { "pop", "r0", NULL },
+};
+
+#define INSTRUMENT_SEQUENCE_LEN                 (sizeof(instrument_sequence) / sizeof(instrument_sequence[0]))
+
+static void instrument_line(compiler_line_t *cl,
+                            compiler_line_t *origin,
+                            compiler_line_type_t type,
+                            const char **token,
+                            uint64_t token_cnt)
+{
+    /* synthesized lines are blamed on the line they were put in front of */
+    memset(cl, 0, sizeof(compiler_line_t));
+    cl->type = type;
+    cl->line_num = origin->line_num;
+    cl->file_idx = origin->file_idx;
+    cl->ci = origin->ci;
+    cl->token = calloc(token_cnt, sizeof(compiler_token_t));
+
+    size_t len = 0;
+    for(uint64_t i = 0; i < token_cnt; i++)
+    {
+        cl->token[cl->token_cnt++].str = strdup(token[i]);
+        len += strlen(token[i]) + 2;
+    }
+
+    cl->str = calloc(len + 1, 1);
+    for(uint64_t i = 0; i < token_cnt; i++)
+    {
+        strcat(cl->str, (i == 0) ? "" : (i == 1) ? " " : ", ");
+        strcat(cl->str, token[i]);
+    }
+}
+
+static bool instrument_block_starts(compiler_line_t *cl)
+{
+    /* directives neither start nor end a block */
+    return cl->type == COMPILER_LINE_TYPE_ASM && cl->token[0].str[0] != '.';
+}
+
+static bool instrument_block_ends(compiler_line_t *cl)
+{
+    /* anything that might not continue with the next line, calls return into a block of their own */
+    return flow_line_is_branch(cl) ||
+           flow_line_ends_block(cl) ||
+           flow_line_opcode(cl) == LA64_OPCODE_BL;
+}
+
+void code_token_instrument(compiler_invocation_t *ci)
+{
+    /* checking if instrumentation was requested in the first place */
+    if(ci->opt->instrument == NULL)
+    {
+        return;
+    }
+
+    FILE *fp = fopen(ci->opt->instrument, "w");
+
+    if(fp == NULL)
+    {
+        diag_perror(ci->opt->instrument);
+        diag_exit(EXIT_FAILURE);
+    }
+
+    code_resource_hold(ci, fp, code_release_file);
+
+    /* counting blocks, they start at labels and behind anything leaving the straight line */
+    uint64_t block_cnt = 0;
+    bool pending = true;
+    for(uint64_t i = 0; i < ci->line_cnt; i++)
+    {
+        compiler_line_t *cl = &(ci->line[i]);
+
+        if(cl->type == COMPILER_LINE_TYPE_GLOBAL_LABEL ||
+           cl->type == COMPILER_LINE_TYPE_LOCAL_LABEL)
+        {
+            pending = true;
+        }
+        else if(instrument_block_starts(cl))
+        {
+            block_cnt += pending;
+            pending = instrument_block_ends(cl);
+        }
+    }
+
+    if(block_cnt == 0)
+    {
+        code_resource_drop(ci, fp);
+        return;
+    }
+
+    /* every block gets its sequence, the counters go to the end of .bss */
+    compiler_line_t *line = calloc(ci->line_cnt + block_cnt * INSTRUMENT_SEQUENCE_LEN + 3, sizeof(compiler_line_t));
+    uint64_t line_cnt = 0;
+    uint64_t block = 0;
+    const char *scope = NULL;
+    compiler_line_t *last = NULL;
+
+    fprintf(fp, "# %s, 8 bytes per counter\n", INSTRUMENT_COUNTERS);
+    fprintf(fp, "# counter file line function\n");
+
+    pending = true;
+    for(uint64_t i = 0; i < ci->line_cnt; i++)
+    {
+        compiler_line_t *cl = &(ci->line[i]);
+
+        if(cl->type == COMPILER_LINE_TYPE_GLOBAL_LABEL ||
+           cl->type == COMPILER_LINE_TYPE_LOCAL_LABEL)
+        {
+            if(cl->type == COMPILER_LINE_TYPE_GLOBAL_LABEL)
+            {
+                scope = cl->token[0].str;
+            }
+
+            pending = true;
+        }
+        else if(instrument_block_starts(cl))
+        {
+            if(pending)
+            {
+                char addr[64];
+                snprintf(addr, sizeof(addr), "%s+%lu", INSTRUMENT_COUNTERS, block * 8);
+
+                for(uint64_t s = 0; s < INSTRUMENT_SEQUENCE_LEN; s++)
+                {
+                    const char *token[3];
+                    uint64_t token_cnt = 0;
+
+                    for(; token_cnt < 3 && instrument_sequence[s][token_cnt] != NULL; token_cnt++)
+                    {
+                        token[token_cnt] = (strcmp(instrument_sequence[s][token_cnt], "%s") == 0) ? addr : instrument_sequence[s][token_cnt];
+                    }
+
+                    instrument_line(&(line[line_cnt++]), cl, COMPILER_LINE_TYPE_ASM, token, token_cnt);
+                }
+
+                /* global labels still carry their ':' */
+                int scope_len = (scope == NULL) ? 1 : (int)strlen(scope) - 1;
+                fprintf(fp, "%lu %s %zu %.*s\n", block, ci->file[cl->file_idx].path, cl->line_num, scope_len, (scope == NULL) ? "-" : scope);
+                block++;
+            }
+
+            pending = instrument_block_ends(cl);
+        }
+
+        if(cl->type != COMPILER_LINE_TYPE_NONE)
+        {
+            last = cl;
+        }
+
+        line[line_cnt++] = *cl;
+    }
+
+    /* reserving the counters */
+    char size[32];
+    snprintf(size, sizeof(size), "%lu", block_cnt * 8);
+
+    const char *section[] = { "section", ".bss" };
+    const char *align[] = { ".align", "8" };
+    const char *counters[] = { INSTRUMENT_COUNTERS, size };
+
+    instrument_line(&(line[line_cnt++]), last, COMPILER_LINE_TYPE_SECTION, section, 2);
+    instrument_line(&(line[line_cnt++]), last, COMPILER_LINE_TYPE_SECTION_DATA, align, 2);
+    instrument_line(&(line[line_cnt++]), last, COMPILER_LINE_TYPE_SECTION_DATA, counters, 2);
+
+    free(ci->line);
+    ci->line = line;
+    ci->line_cnt = line_cnt;
+    code_line_relink(ci);
+
+    code_resource_drop(ci, fp);
+}
@@ -0,0 +1,196 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2024 cr4zyengineer
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <la64asm/intern.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+
+#define INTERN_ARENA_SIZE                       0x10000
+#define INTERN_TABLE_MIN                        0x400
+
+typedef struct {
+    const char **slot;                      /* open addressed strings, NULL if free */
+    uint64_t size;                          /* count of slots, always a power of two */
+    uint64_t cnt;                           /* count of strings */
+    char *arena;                            /* free space of the current arena */
+    size_t arena_left;                      /* bytes left in the current arena */
+} intern_table_t;
+
+static _Thread_local intern_table_t intern_table;
+
+static uint64_t intern_hash_bytes(const char *str,
+                                  size_t len)
+{
+    /* fnv-1a, identifiers are short */
+    uint64_t hash = 0xcbf29ce484222325ull;
+
+    for(size_t i = 0; i < len; i++)
+    {
+        hash ^= (unsigned char)str[i];
+        hash *= 0x100000001b3ull;
+    }
+
+    return hash;
+}
+
+static const char **intern_probe(const char **slot,
+                                 uint64_t size,
+                                 uint64_t hash,
+                                 const char *str,
+                                 size_t len)
+{
+    for(uint64_t i = hash & (size - 1);; i = (i + 1) & (size - 1))
+    {
+        /* the stored hash rules out nearly every mismatch before the bytes are compared */
+        if(slot[i] == NULL ||
+           (intern_hash(slot[i]) == hash && strncmp(slot[i], str, len) == 0 && slot[i][len] == '\0'))
+        {
+            return &(slot[i]);
+        }
+    }
+}
+
+static void intern_grow(void)
+{
+    intern_table_t *it = &intern_table;
+    uint64_t size = (it->size == 0) ? INTERN_TABLE_MIN : it->size * 2;
+    const char **slot = calloc(size, sizeof(const char*));
+
+    for(uint64_t i = 0; i < it->size; i++)
+    {
+        if(it->slot[i] != NULL)
+        {
+            const char *str = it->slot[i];
+            *intern_probe(slot, size, intern_hash(str), str, strlen(str)) = str;
+        }
+    }
+
+    free(it->slot);
+    it->slot = slot;
+    it->size = size;
+}
+
+static const char *intern_store(uint64_t hash,
+                                const char *str,
+                                size_t len)
+{
+    intern_table_t *it = &intern_table;
+
+    /* hash in front, string behind, padded so the next hash is aligned */
+    size_t need = (sizeof(uint64_t) + len + 1 + 7) & ~(size_t)7;
+    char *mem = NULL;
+
+    if(need > INTERN_ARENA_SIZE / 4)
+    {
+        mem = malloc(need);
+    }
+    else
+    {
+        if(need > it->arena_left)
+        {
+            it->arena = malloc(INTERN_ARENA_SIZE);
+            it->arena_left = INTERN_ARENA_SIZE;
+        }
+
+        mem = it->arena;
+        it->arena += need;
+        it->arena_left -= need;
+    }
+
+    if(mem == NULL)
+    {
+        perror("intern");
+        exit(EXIT_FAILURE);
+    }
+
+    memcpy(mem, &hash, sizeof(uint64_t));
+    memcpy(mem + sizeof(uint64_t), str, len);
+    mem[sizeof(uint64_t) + len] = '\0';
+
+    return mem + sizeof(uint64_t);
+}
+
+const char *intern_n(const char *str,
+                     size_t len)
+{
+    intern_table_t *it = &intern_table;
+
+    /* keeping the load at or below one half */
+    if((it->cnt + 1) * 2 > it->size)
+    {
+        intern_grow();
+    }
+
+    uint64_t hash = intern_hash_bytes(str, len);
+    const char **slot = intern_probe(it->slot, it->size, hash, str, len);
+
+    if(*slot == NULL)
+    {
+        *slot = intern_store(hash, str, len);
+        it->cnt++;
+    }
+
+    return *slot;
+}
+
+const char *intern(const char *str)
+{
+    return intern_n(str, strlen(str));
+}
+
+const char *intern_cat(const char *a,
+                       const char *b)
+{
+    size_t alen = strlen(a);
+    size_t blen = strlen(b);
+    char buf[256];
+    char *cat = (alen + blen < sizeof(buf)) ? buf : malloc(alen + blen + 1);
+
+    memcpy(cat, a, alen);
+    memcpy(cat + alen, b, blen + 1);
+
+    const char *str = intern_n(cat, alen + blen);
+
+    if(cat != buf)
+    {
+        free(cat);
+    }
+
+    return str;
+}
+
+const char *intern_find(const char *str)
+{
+    intern_table_t *it = &intern_table;
+
+    if(it->size == 0)
+    {
+        return NULL;
+    }
+
+    size_t len = strlen(str);
+    return *intern_probe(it->slot, it->size, intern_hash_bytes(str, len), str, len);
+}
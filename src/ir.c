@@ -0,0 +1,209 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2024 cr4zyengineer
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <la64asm/ir.h>
+#include <la64asm/diag.h>
+#include <la64asm/expr.h>
+#include <la64asm/intern.h>
+#include <la64asm/number.h>
+#include <la64asm/opcode.h>
+#include <la64asm/register.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <lautils/parser.h>
+
+static bool ir_line_is_directive(compiler_line_t *cl)
+{
+    /* alignment is done by whoever emits the section */
+    return strcmp(cl->token[0].str, ".align") == 0 ||
+           strcmp(cl->token[0].str, ".balign") == 0;
+}
+
+static void ir_operand_symbol(compiler_ir_t *ir,
+                              uint64_t op,
+                              const char *str,
+                              const char *scope)
+{
+    /* local labels live in the scope of the global one */
+    ir->kind[op] = COMPILER_IR_OPERAND_SYM;
+    ir->value[op] = 0;
+    ir->sym[op] = (str[0] == '.' && scope != NULL) ? intern_cat(scope, str) : intern(str);
+}
+
+static void ir_operand(compiler_invocation_t *ci,
+                       compiler_token_t *ct,
+                       const char *scope)
+{
+    compiler_ir_t *ir = &(ci->ir);
+    uint64_t op = ir->value_cnt++;
+    const char *str = ct->str;
+    char c = str[0];
+
+    ir->sym[op] = NULL;
+    ir->sub[op] = NULL;
+
+    /* plain numbers never need the generic parser */
+    if(c >= '0' && c <= '9' &&
+       number_parse(str, &(ir->value[op])))
+    {
+        ir->kind[op] = COMPILER_IR_OPERAND_IMM;
+        return;
+    }
+
+    /* folding expressions at assemble time */
+    if(expr_is_expression(str))
+    {
+        expr_value_t ev = { 0 };
+        expr_eval(ci, ct, scope, &ev);
+
+        /* label relative ones keep the label, the relocation carries the rest */
+        ir->kind[op] = (ev.sym == NULL) ? COMPILER_IR_OPERAND_IMM : COMPILER_IR_OPERAND_SYM;
+        ir->value[op] = ev.value;
+        ir->sym[op] = (ev.sym == NULL) ? NULL : intern(ev.sym);
+        ir->sub[op] = (ev.sub == NULL) ? NULL : intern(ev.sub);
+
+        free(ev.sym);
+        free(ev.sub);
+        return;
+    }
+
+    /* labels start with '_' or '.', neither of which any literal starts with */
+    if(c == '_' || c == '.')
+    {
+        ir_operand_symbol(ir, op, str, scope);
+        return;
+    }
+
+    /* registers are lower case letters followed by at most two more characters */
+    if(c >= 'a' && c <= 'z' && strlen(str) <= 3)
+    {
+        register_entry_t *reg = register_from_string(str);
+
+        if(reg != NULL)
+        {
+            ir->kind[op] = COMPILER_IR_OPERAND_REG;
+            ir->value[op] = reg->reg;
+            return;
+        }
+    }
+
+    /* quoted literals and whatever else the generic parser knows */
+    parser_return_t pr = parse_value_from_string(str);
+
+    if(pr.type != laParserValueTypeString)
+    {
+        ir->kind[op] = COMPILER_IR_OPERAND_IMM;
+        ir->value[op] = pr.value;
+        return;
+    }
+
+    ir_operand_symbol(ir, op, str, scope);
+}
+
+void code_ir_build(compiler_invocation_t *ci)
+{
+    compiler_ir_t *ir = &(ci->ir);
+
+    /* sizing the arrays, operands of hlt, nop and ret are never looked at but counting them is cheaper */
+    uint64_t instr_cnt = 0;
+    uint64_t value_cnt = 0;
+    for(uint64_t i = 0; i < ci->line_cnt; i++)
+    {
+        if(ci->line[i].type == COMPILER_LINE_TYPE_ASM)
+        {
+            instr_cnt++;
+            value_cnt += ci->line[i].token_cnt - 1;
+        }
+    }
+
+    ir->line = calloc(instr_cnt, sizeof(uint64_t));
+    ir->opcode = calloc(instr_cnt, sizeof(uint8_t));
+    ir->operand_cnt = calloc(instr_cnt, sizeof(uint8_t));
+    ir->operand = calloc(instr_cnt, sizeof(uint64_t));
+    ir->kind = calloc(value_cnt, sizeof(uint8_t));
+    ir->value = calloc(value_cnt, sizeof(uint64_t));
+    ir->sym = calloc(value_cnt, sizeof(const char*));
+    ir->sub = calloc(value_cnt, sizeof(const char*));
+    ir->instr_cnt = 0;
+    ir->value_cnt = 0;
+
+    /* local labels resolve against the last global label in source order */
+    const char *scope = NULL;
+
+    for(uint64_t i = 0; i < ci->line_cnt; i++)
+    {
+        compiler_line_t *cl = &(ci->line[i]);
+        cl->instr = COMPILER_IR_NONE;
+
+        if(cl->type == COMPILER_LINE_TYPE_GLOBAL_LABEL)
+        {
+            scope = intern_n(cl->token[0].str, strlen(cl->token[0].str) - 1);
+            continue;
+        }
+
+        if(cl->type != COMPILER_LINE_TYPE_ASM ||
+           ir_line_is_directive(cl))
+        {
+            continue;
+        }
+
+        /* parameter count check */
+        if(cl->token_cnt > 32)
+        {
+            diag_error(&(cl->token[0]), "holy smokes, why soo many operands, maximum is 32 operands in 64bit lightweight architecture\n");
+        }
+
+        /* getting opcode entry if it exists */
+        opcode_entry_t *opce = opcode_from_string(cl->token[0].str);
+
+        if(opce == NULL)
+        {
+            diag_error(&(cl->token[0]), "illegal opcode \"%s\"\n", cl->token[0].str);
+        }
+
+        uint64_t instr = ir->instr_cnt++;
+        cl->instr = instr;
+        ir->line[instr] = i;
+        ir->opcode[instr] = opce->opcode;
+        ir->operand[instr] = ir->value_cnt;
+        ir->operand_cnt[instr] = 0;
+
+        /* those are a single byte, whatever follows them */
+        if(opce->opcode == LA64_OPCODE_HLT ||
+           opce->opcode == LA64_OPCODE_NOP ||
+           opce->opcode == LA64_OPCODE_RET)
+        {
+            continue;
+        }
+
+        for(uint64_t a = 1; a < cl->token_cnt; a++)
+        {
+            ir_operand(ci, &(cl->token[a]), scope);
+        }
+
+        ir->operand_cnt[instr] = cl->token_cnt - 1;
+    }
+}
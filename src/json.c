@@ -0,0 +1,444 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2024 cr4zyengineer
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <la64asm/json.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+#define JSON_DEPTH_MAX                          128
+
+typedef struct {
+    const char *str;                        /* text being parsed */
+    size_t len;                             /* length of the text */
+    size_t off;                             /* current offset */
+} json_parser_t;
+
+static bool json_value(json_parser_t *jp, json_t *js, unsigned depth);
+
+static void json_skip(json_parser_t *jp)
+{
+    while(jp->off < jp->len && isspace((unsigned char)jp->str[jp->off]))
+    {
+        jp->off++;
+    }
+}
+
+static bool json_literal(json_parser_t *jp,
+                         const char *lit)
+{
+    size_t len = strlen(lit);
+
+    if(jp->len - jp->off < len || strncmp(&(jp->str[jp->off]), lit, len) != 0)
+    {
+        return false;
+    }
+
+    jp->off += len;
+    return true;
+}
+
+static bool json_hex4(json_parser_t *jp,
+                      uint32_t *cp)
+{
+    *cp = 0;
+
+    for(int i = 0; i < 4; i++, jp->off++)
+    {
+        if(jp->off >= jp->len || !isxdigit((unsigned char)jp->str[jp->off]))
+        {
+            return false;
+        }
+
+        char c = jp->str[jp->off];
+        *cp = (*cp << 4) | (isdigit((unsigned char)c) ? c - '0' : (tolower((unsigned char)c) - 'a' + 10));
+    }
+
+    return true;
+}
+
+static size_t json_utf8(char *out,
+                        uint32_t cp)
+{
+    if(cp < 0x80)
+    {
+        out[0] = cp;
+        return 1;
+    }
+    else if(cp < 0x800)
+    {
+        out[0] = 0xc0 | (cp >> 6);
+        out[1] = 0x80 | (cp & 0x3f);
+        return 2;
+    }
+    else if(cp < 0x10000)
+    {
+        out[0] = 0xe0 | (cp >> 12);
+        out[1] = 0x80 | ((cp >> 6) & 0x3f);
+        out[2] = 0x80 | (cp & 0x3f);
+        return 3;
+    }
+
+    out[0] = 0xf0 | (cp >> 18);
+    out[1] = 0x80 | ((cp >> 12) & 0x3f);
+    out[2] = 0x80 | ((cp >> 6) & 0x3f);
+    out[3] = 0x80 | (cp & 0x3f);
+    return 4;
+}
+
+static char *json_string_parse(json_parser_t *jp)
+{
+    if(jp->off >= jp->len || jp->str[jp->off] != '"')
+    {
+        return NULL;
+    }
+
+    jp->off++;
+
+    /* escapes only ever shrink, so the raw length is enough */
+    size_t start = jp->off;
+    for(; jp->off < jp->len && jp->str[jp->off] != '"'; jp->off++)
+    {
+        jp->off += (jp->str[jp->off] == '\\');
+    }
+
+    if(jp->off >= jp->len)
+    {
+        return NULL;
+    }
+
+    char *out = malloc(jp->off - start + 1);
+    size_t n = 0;
+    size_t end = jp->off;
+    jp->off = start;
+
+    while(jp->off < end)
+    {
+        char c = jp->str[jp->off++];
+
+        if(c != '\\')
+        {
+            out[n++] = c;
+            continue;
+        }
+
+        uint32_t cp = 0;
+        switch(jp->str[jp->off++])
+        {
+            case '"': out[n++] = '"'; break;
+            case '\\': out[n++] = '\\'; break;
+            case '/': out[n++] = '/'; break;
+            case 'b': out[n++] = '\b'; break;
+            case 'f': out[n++] = '\f'; break;
+            case 'n': out[n++] = '\n'; break;
+            case 'r': out[n++] = '\r'; break;
+            case 't': out[n++] = '\t'; break;
+            case 'u':
+                if(!json_hex4(jp, &cp))
+                {
+                    free(out);
+                    return NULL;
+                }
+
+                /* surrogate pairs make up one code point */
+                if(cp >= 0xd800 && cp < 0xdc00 &&
+                   end - jp->off >= 6 && jp->str[jp->off] == '\\' && jp->str[jp->off + 1] == 'u')
+                {
+                    uint32_t lo = 0;
+                    jp->off += 2;
+
+                    if(!json_hex4(jp, &lo))
+                    {
+                        free(out);
+                        return NULL;
+                    }
+
+                    cp = 0x10000 + ((cp - 0xd800) << 10) + (lo - 0xdc00);
+                }
+
+                n += json_utf8(&out[n], cp);
+                break;
+            default:
+                free(out);
+                return NULL;
+        }
+    }
+
+    out[n] = '\0';
+    jp->off = end + 1;
+    return out;
+}
+
+static bool json_push(json_t *parent,
+                      json_t *child)
+{
+    parent->child = realloc(parent->child, (parent->child_cnt + 1) * sizeof(json_t));
+    parent->child[parent->child_cnt++] = *child;
+    return true;
+}
+
+static bool json_container(json_parser_t *jp,
+                           json_t *js,
+                           unsigned depth)
+{
+    bool object = (jp->str[jp->off++] == '{');
+    char close = object ? '}' : ']';
+
+    js->type = object ? JSON_OBJECT : JSON_ARRAY;
+    json_skip(jp);
+
+    if(jp->off < jp->len && jp->str[jp->off] == close)
+    {
+        jp->off++;
+        return true;
+    }
+
+    for(;;)
+    {
+        json_t child = { 0 };
+        json_skip(jp);
+
+        if(object)
+        {
+            child.key = json_string_parse(jp);
+            json_skip(jp);
+
+            if(child.key == NULL || jp->off >= jp->len || jp->str[jp->off++] != ':')
+            {
+                free(child.key);
+                return false;
+            }
+        }
+
+        if(!json_value(jp, &child, depth + 1))
+        {
+            json_free(&child);
+            return false;
+        }
+
+        json_push(js, &child);
+        json_skip(jp);
+
+        if(jp->off >= jp->len)
+        {
+            return false;
+        }
+
+        char c = jp->str[jp->off++];
+
+        if(c == close)
+        {
+            return true;
+        }
+        else if(c != ',')
+        {
+            return false;
+        }
+    }
+}
+
+static bool json_value(json_parser_t *jp,
+                       json_t *js,
+                       unsigned depth)
+{
+    json_skip(jp);
+
+    if(jp->off >= jp->len || depth > JSON_DEPTH_MAX)
+    {
+        return false;
+    }
+
+    char c = jp->str[jp->off];
+
+    if(c == '{' || c == '[')
+    {
+        return json_container(jp, js, depth);
+    }
+    else if(c == '"')
+    {
+        js->type = JSON_STRING;
+        js->str = json_string_parse(jp);
+        return js->str != NULL;
+    }
+    else if(json_literal(jp, "true") || json_literal(jp, "false"))
+    {
+        js->type = JSON_BOOL;
+        js->num = (c == 't');
+        return true;
+    }
+    else if(json_literal(jp, "null"))
+    {
+        js->type = JSON_NULL;
+        return true;
+    }
+
+    /* the text is not terminated, so the number is copied out first */
+    char buf[64];
+    size_t n = 0;
+    for(; jp->off < jp->len && n < sizeof(buf) - 1 && strchr("+-0123456789.eE", jp->str[jp->off]) != NULL; jp->off++)
+    {
+        buf[n++] = jp->str[jp->off];
+    }
+
+    buf[n] = '\0';
+
+    char *end = NULL;
+    js->type = JSON_NUMBER;
+    js->num = strtod(buf, &end);
+    return n > 0 && *end == '\0';
+}
+
+json_t *json_parse(const char *str,
+                   size_t len)
+{
+    json_parser_t jp = { .str = str, .len = len };
+    json_t *js = calloc(1, sizeof(json_t));
+
+    if(!json_value(&jp, js, 0))
+    {
+        json_free(js);
+        free(js);
+        return NULL;
+    }
+
+    return js;
+}
+
+void json_free(json_t *js)
+{
+    /* releases what the value holds, not the value itself */
+    for(uint64_t i = 0; i < js->child_cnt; i++)
+    {
+        json_free(&(js->child[i]));
+    }
+
+    free(js->child);
+    free(js->key);
+    free(js->str);
+}
+
+json_t *json_get(json_t *js,
+                 const char *key)
+{
+    if(js == NULL || js->type != JSON_OBJECT)
+    {
+        return NULL;
+    }
+
+    for(uint64_t i = 0; i < js->child_cnt; i++)
+    {
+        if(strcmp(js->child[i].key, key) == 0)
+        {
+            return &(js->child[i]);
+        }
+    }
+
+    return NULL;
+}
+
+const char *json_string(json_t *js)
+{
+    return (js == NULL || js->type != JSON_STRING) ? NULL : js->str;
+}
+
+double json_number(json_t *js,
+                   double def)
+{
+    return (js == NULL || (js->type != JSON_NUMBER && js->type != JSON_BOOL)) ? def : js->num;
+}
+
+void json_write_string(FILE *fp,
+                       const char *str)
+{
+    fputc('"', fp);
+
+    for(; *str != '\0'; str++)
+    {
+        unsigned char c = *str;
+
+        if(c == '"' || c == '\\')
+        {
+            fputc('\\', fp);
+            fputc(c, fp);
+        }
+        else if(c < 0x20)
+        {
+            fprintf(fp, "\\u%04x", c);
+        }
+        else
+        {
+            fputc(c, fp);
+        }
+    }
+
+    fputc('"', fp);
+}
+
+void json_write(FILE *fp,
+                json_t *js)
+{
+    if(js == NULL)
+    {
+        fputs("null", fp);
+        return;
+    }
+
+    switch(js->type)
+    {
+        case JSON_BOOL:
+            fputs(js->num ? "true" : "false", fp);
+            break;
+        case JSON_NUMBER:
+            fprintf(fp, "%.17g", js->num);
+            break;
+        case JSON_STRING:
+            json_write_string(fp, js->str);
+            break;
+        case JSON_ARRAY:
+        case JSON_OBJECT:
+            fputc((js->type == JSON_OBJECT) ? '{' : '[', fp);
+
+            for(uint64_t i = 0; i < js->child_cnt; i++)
+            {
+                if(i > 0)
+                {
+                    fputc(',', fp);
+                }
+
+                if(js->type == JSON_OBJECT)
+                {
+                    json_write_string(fp, js->child[i].key);
+                    fputc(':', fp);
+                }
+
+                json_write(fp, &(js->child[i]));
+            }
+
+            fputc((js->type == JSON_OBJECT) ? '}' : ']', fp);
+            break;
+        default:
+            fputs("null", fp);
+            break;
+    }
+}
@@ -29,6 +29,7 @@
 #include <ctype.h>
 #include <la64asm/label.h>
 #include <la64asm/diag.h>
+#include <la64asm/intern.h>
 #include <unistd.h>
 
 void code_token_label(compiler_invocation_t *ci)
@@ -48,25 +49,62 @@ void code_token_label(compiler_invocation_t *ci)
     /* allocating memory for those */
     ci->label = calloc(ci->label_cnt, sizeof(compiler_label_t));
 
+    /* the index stays at most half full, so probing ends quickly */
+    ci->label_hash_size = 16;
+    while(ci->label_hash_size < ci->label_cnt * 2)
+    {
+        ci->label_hash_size *= 2;
+    }
+
+    ci->label_hash = calloc(ci->label_hash_size, sizeof(uint64_t));
+
     /* reset label count for compiler */
     ci->label_cnt = 0;
 }
 
-compiler_label_t *label_lookup_internal(compiler_invocation_t *ci,
-                                        const char *name)
+static uint64_t *label_slot(compiler_invocation_t *ci,
+                            const char *name)
 {
-    /* iterating through all labels */
-    for(int i = 0; i < ci->label_cnt; i++)
+    /* names are interned, so comparing pointers is comparing names */
+    uint64_t mask = ci->label_hash_size - 1;
+
+    for(uint64_t i = intern_hash(name) & mask;; i = (i + 1) & mask)
     {
-        /* checking if request name matches */
-        if(strcmp(ci->label[i].name, name) == 0)
+        if(ci->label_hash[i] == 0 ||
+           ci->label[ci->label_hash[i] - 1].name == name)
         {
-            /* returning label address*/
-            return &(ci->label[i]);
+            return &(ci->label_hash[i]);
         }
     }
+}
+
+compiler_label_t *label_lookup_internal(compiler_invocation_t *ci,
+                                        const char *name)
+{
+    /* the name has to be interned already */
+    uint64_t idx = *label_slot(ci, name);
+    return (idx == 0) ? NULL : &(ci->label[idx - 1]);
+}
+
+uint64_t label_add(compiler_invocation_t *ci,
+                   const char *name,
+                   uint64_t addr,
+                   compiler_token_t *ctlink)
+{
+    compiler_label_t *label = &(ci->label[ci->label_cnt]);
+    label->name = intern(name);
+    label->addr = addr;
+    label->ctlink = ctlink;
+
+    /* the first definition wins, later ones are only reachable through the array */
+    uint64_t *slot = label_slot(ci, label->name);
+
+    if(*slot == 0)
+    {
+        *slot = ci->label_cnt + 1;
+    }
 
-    return NULL;
+    return ci->label_cnt++;
 }
 
 void code_token_label_append(compiler_token_t *ct)
@@ -75,13 +113,8 @@ void code_token_label_append(compiler_token_t *ct)
     compiler_line_t *cl = ct->cl;
     compiler_invocation_t *ci = cl->ci;
 
-    /* assign address to label */
-    ci->label[ci->label_cnt].addr = ci->image_addr;
-
-    /* copying label name */
-    size_t size = strlen(ct->str);
-    char *name = strdup(ct->str);
-    name[size - 1] = '\0';
+    /* label name without the ':' */
+    const char *name = intern_n(ct->str, strlen(ct->str) - 1);
 
     /* checking if its in scope */
     if(ct->cl->type == COMPILER_LINE_TYPE_LOCAL_LABEL)
@@ -92,15 +125,7 @@ void code_token_label_append(compiler_token_t *ct)
             diag_error(ct, "defining a local label out of any global label is illegal \"%s\"\n", name);
         }
 
-        /* adjust size */
-        size += strlen(ci->label_scope);
-
-        /* reallocate buffer */
-        name = realloc(name, (size) + 1);
-
-        /* recopy */
-        sprintf(name, "%s%s", ci->label_scope, cl->str);
-        name[size - 1] = '\0';
+        name = intern_cat(ci->label_scope, name);
     }
     else
     {
@@ -118,8 +143,7 @@ void code_token_label_append(compiler_token_t *ct)
         diag_error(ct, "duplicated label \"%s\"\n", name);
     }
 
-    ci->label[ci->label_cnt].ctlink = ct;
-    ci->label[ci->label_cnt++].name = name;
+    label_add(ci, name, ci->image_addr, ct);
 }
 
 uint64_t label_lookup(compiler_invocation_t *ci,
@@ -133,7 +157,7 @@ uint64_t label_lookup(compiler_invocation_t *ci,
 void code_token_label_insert_start(compiler_invocation_t *ci)
 {
     /* finding start label */
-    uint64_t addr = label_lookup(ci, "_start");
+    uint64_t addr = label_lookup(ci, intern("_start"));
 
     if(addr == COMPILER_LABEL_NOT_FOUND)
     {
@@ -142,6 +166,6 @@ void code_token_label_insert_start(compiler_invocation_t *ci)
 
     /* writing start address into the start of the image */
     bitwalker_t bw;
-    bitwalker_init(&bw, ci->image, 8, BW_LITTLE_ENDIAN);
+    bitwalker_init(&bw, &(ci->image[COMPILER_IMAGE_HEADER_ENTRY]), 8, BW_LITTLE_ENDIAN);
     bitwalker_write(&bw, addr, 64);
 }
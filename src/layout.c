@@ -0,0 +1,455 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2024 cr4zyengineer
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <la64asm/layout.h>
+#include <la64asm/flow.h>
+#include <la64asm/code.h>
+#include <la64asm/diag.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+
+#define LAYOUT_NONE                             UINT64_MAX
+
+typedef struct {
+    uint64_t first;                         /* first line of the group */
+    uint64_t last;                          /* last line of the group (inclusive) */
+    uint64_t weight;                        /* samples of every function in the group */
+    uint64_t size;                          /* instructions in the group */
+    uint64_t chain;                         /* chain the group is part of */
+    uint64_t next;                          /* next group of the chain, LAYOUT_NONE at its end */
+} layout_group_t;
+
+typedef struct {
+    char *name;                             /* name of the global label */
+    uint64_t group;                         /* group the function lives in */
+} layout_func_t;
+
+typedef struct {
+    uint64_t from;                          /* group of the caller */
+    uint64_t to;                            /* group of the callee */
+    uint64_t weight;                        /* calls or samples along the edge */
+} layout_edge_t;
+
+typedef struct {
+    uint64_t head;                          /* first group of the chain */
+    uint64_t tail;                          /* last group of the chain */
+    uint64_t weight;                        /* samples of every group in the chain */
+    uint64_t size;                          /* instructions of every group in the chain */
+} layout_chain_t;
+
+typedef struct {
+    layout_group_t *group;                  /* groups in source order */
+    uint64_t group_cnt;                     /* count of groups */
+    layout_func_t *func;                    /* functions sorted by name */
+    uint64_t func_cnt;                      /* count of functions */
+    layout_edge_t *edge;                    /* call graph edges */
+    uint64_t edge_cnt;                      /* count of edges */
+    layout_chain_t *chain;                  /* chains, indexed by the group they started with */
+} layout_t;
+
+static int layout_func_compare(const void *a,
+                               const void *b)
+{
+    return strcmp(((const layout_func_t*)a)->name, ((const layout_func_t*)b)->name);
+}
+
+static uint64_t layout_func_group(layout_t *ly,
+                                  const char *name)
+{
+    layout_func_t key = { .name = (char*)name };
+    layout_func_t *func = bsearch(&key, ly->func, ly->func_cnt, sizeof(layout_func_t), layout_func_compare);
+    return (func == NULL) ? LAYOUT_NONE : func->group;
+}
+
+static void layout_edge_add(layout_t *ly,
+                            uint64_t from,
+                            uint64_t to,
+                            uint64_t weight)
+{
+    if(from == LAYOUT_NONE || to == LAYOUT_NONE || from == to || weight == 0)
+    {
+        return;
+    }
+
+    ly->edge = realloc(ly->edge, (ly->edge_cnt + 1) * sizeof(layout_edge_t));
+    ly->edge[ly->edge_cnt].from = from;
+    ly->edge[ly->edge_cnt].to = to;
+    ly->edge[ly->edge_cnt++].weight = weight;
+}
+
+static void layout_build(compiler_invocation_t *ci,
+                         layout_t *ly)
+{
+    /* global labels own everything up to the next one */
+    for(uint64_t i = 0; i < ci->line_cnt; i++)
+    {
+        if(ci->line[i].type == COMPILER_LINE_TYPE_GLOBAL_LABEL)
+        {
+            ly->func_cnt++;
+        }
+    }
+
+    ly->group = calloc(ly->func_cnt, sizeof(layout_group_t));
+    ly->func = calloc(ly->func_cnt, sizeof(layout_func_t));
+    ly->func_cnt = 0;
+
+    /* functions falling through into the next one stay glued to it */
+    layout_group_t *group = NULL;
+    compiler_line_t *last = NULL;
+    for(uint64_t i = 0; i < ci->line_cnt; i++)
+    {
+        compiler_line_t *cl = &(ci->line[i]);
+
+        if(cl->type == COMPILER_LINE_TYPE_GLOBAL_LABEL)
+        {
+            if(group == NULL || (last != NULL && flow_line_ends_block(last)))
+            {
+                group = &(ly->group[ly->group_cnt]);
+                group->first = i;
+                group->chain = ly->group_cnt;
+                group->next = LAYOUT_NONE;
+                ly->group_cnt++;
+            }
+
+            ly->func[ly->func_cnt].name = strndup(cl->token[0].str, strlen(cl->token[0].str) - 1);
+            ly->func[ly->func_cnt++].group = group - ly->group;
+            last = NULL;
+        }
+        else if(group != NULL && cl->type == COMPILER_LINE_TYPE_ASM)
+        {
+            /* directives like .align do not end a block */
+            if(cl->token[0].str[0] != '.')
+            {
+                last = cl;
+                group->size++;
+            }
+        }
+
+        if(group != NULL)
+        {
+            group->last = i;
+        }
+    }
+
+    qsort(ly->func, ly->func_cnt, sizeof(layout_func_t), layout_func_compare);
+
+    ly->chain = calloc(ly->group_cnt, sizeof(layout_chain_t));
+}
+
+static void layout_profile_load(compiler_invocation_t *ci,
+                                layout_t *ly)
+{
+    const char *path = ci->opt->profile;
+    FILE *fp = fopen(path, "r");
+
+    if(fp == NULL)
+    {
+        diag_perror(path);
+        diag_exit(EXIT_FAILURE);
+    }
+
+    /* "function count" weighs a function, "caller callee count" weighs a call */
+    char *line = NULL;
+    size_t cap = 0;
+    uint64_t num = 0;
+
+    while(getline(&line, &cap, fp) > 0)
+    {
+        num++;
+        line[strcspn(line, "#\r\n")] = '\0';
+
+        char *field[4] = { NULL };
+        int field_cnt = 0;
+        char *save = NULL;
+
+        for(char *tok = strtok_r(line, " \t", &save); tok != NULL; tok = strtok_r(NULL, " \t", &save))
+        {
+            if(field_cnt == 4)
+            {
+                break;
+            }
+
+            field[field_cnt++] = tok;
+        }
+
+        if(field_cnt == 0)
+        {
+            continue;
+        }
+
+        char *end = NULL;
+        uint64_t count = (field_cnt > 1) ? strtoull(field[field_cnt - 1], &end, 0) : 0;
+
+        if(field_cnt < 2 || field_cnt > 3 || *end != '\0')
+        {
+            fprintf(diag_file(stderr), "%s:%lu: expected \"function count\" or \"caller callee count\"\n", path, num);
+            free(line);
+            fclose(fp);
+            diag_exit(EXIT_FAILURE);
+        }
+
+        /* functions the profile knows but the source does not are stale entries */
+        if(field_cnt == 2)
+        {
+            uint64_t group = layout_func_group(ly, field[0]);
+
+            if(group != LAYOUT_NONE)
+            {
+                ly->group[group].weight += count;
+            }
+        }
+        else
+        {
+            layout_edge_add(ly, layout_func_group(ly, field[0]), layout_func_group(ly, field[1]), count);
+        }
+    }
+
+    free(line);
+    fclose(fp);
+}
+
+static void layout_static_edges(compiler_invocation_t *ci,
+                                layout_t *ly)
+{
+    /* calls in the source tie hot callers to hot callees even without sampled edges */
+    for(uint64_t g = 0; g < ly->group_cnt; g++)
+    {
+        for(uint64_t i = ly->group[g].first; i <= ly->group[g].last; i++)
+        {
+            compiler_line_t *cl = &(ci->line[i]);
+
+            if(flow_line_opcode(cl) != LA64_OPCODE_BL)
+            {
+                continue;
+            }
+
+            compiler_token_t *target = flow_line_target(cl);
+
+            if(target == NULL || target->str[0] == '.')
+            {
+                continue;
+            }
+
+            uint64_t to = layout_func_group(ly, target->str);
+
+            if(to != LAYOUT_NONE)
+            {
+                uint64_t from_weight = ly->group[g].weight;
+                uint64_t to_weight = ly->group[to].weight;
+                layout_edge_add(ly, g, to, (from_weight < to_weight) ? from_weight : to_weight);
+            }
+        }
+    }
+}
+
+static int layout_edge_pair_compare(const void *a,
+                                    const void *b)
+{
+    const layout_edge_t *ea = a;
+    const layout_edge_t *eb = b;
+
+    if(ea->from != eb->from)
+    {
+        return (ea->from < eb->from) ? -1 : 1;
+    }
+
+    return (ea->to < eb->to) ? -1 : (ea->to > eb->to);
+}
+
+static int layout_edge_weight_compare(const void *a,
+                                      const void *b)
+{
+    const layout_edge_t *ea = a;
+    const layout_edge_t *eb = b;
+
+    if(ea->weight != eb->weight)
+    {
+        return (ea->weight < eb->weight) ? 1 : -1;
+    }
+
+    return layout_edge_pair_compare(a, b);
+}
+
+static void layout_chain_merge(layout_t *ly)
+{
+    for(uint64_t g = 0; g < ly->group_cnt; g++)
+    {
+        ly->chain[g].head = g;
+        ly->chain[g].tail = g;
+        ly->chain[g].weight = ly->group[g].weight;
+        ly->chain[g].size = ly->group[g].size;
+    }
+
+    /* summing up parallel edges */
+    qsort(ly->edge, ly->edge_cnt, sizeof(layout_edge_t), layout_edge_pair_compare);
+
+    uint64_t cnt = 0;
+    for(uint64_t i = 0; i < ly->edge_cnt; i++)
+    {
+        if(cnt > 0 && layout_edge_pair_compare(&(ly->edge[cnt - 1]), &(ly->edge[i])) == 0)
+        {
+            ly->edge[cnt - 1].weight += ly->edge[i].weight;
+        }
+        else
+        {
+            ly->edge[cnt++] = ly->edge[i];
+        }
+    }
+
+    ly->edge_cnt = cnt;
+
+    /* heaviest calls first, the callee chain goes right behind the caller chain */
+    qsort(ly->edge, ly->edge_cnt, sizeof(layout_edge_t), layout_edge_weight_compare);
+
+    for(uint64_t i = 0; i < ly->edge_cnt; i++)
+    {
+        uint64_t a = ly->group[ly->edge[i].from].chain;
+        uint64_t b = ly->group[ly->edge[i].to].chain;
+
+        if(a == b)
+        {
+            continue;
+        }
+
+        ly->group[ly->chain[a].tail].next = ly->chain[b].head;
+        ly->chain[a].tail = ly->chain[b].tail;
+        ly->chain[a].weight += ly->chain[b].weight;
+        ly->chain[a].size += ly->chain[b].size;
+
+        for(uint64_t g = ly->chain[b].head; g != LAYOUT_NONE; g = ly->group[g].next)
+        {
+            ly->group[g].chain = a;
+        }
+
+        ly->chain[b].head = LAYOUT_NONE;
+    }
+}
+
+static _Thread_local layout_t *layout_sort_ctx;
+
+static int layout_chain_compare(const void *a,
+                                const void *b)
+{
+    const layout_chain_t *ca = &(layout_sort_ctx->chain[*(const uint64_t*)a]);
+    const layout_chain_t *cb = &(layout_sort_ctx->chain[*(const uint64_t*)b]);
+
+    /* hot chains by density, cold chains keep their source order */
+    double da = (double)ca->weight / (double)(ca->size + 1);
+    double db = (double)cb->weight / (double)(cb->size + 1);
+
+    if(da != db)
+    {
+        return (da < db) ? 1 : -1;
+    }
+
+    return (ca->head < cb->head) ? -1 : (ca->head > cb->head);
+}
+
+static void layout_free(layout_t *ly)
+{
+    for(uint64_t i = 0; i < ly->func_cnt; i++)
+    {
+        free(ly->func[i].name);
+    }
+
+    free(ly->group);
+    free(ly->func);
+    free(ly->edge);
+    free(ly->chain);
+}
+
+static void layout_release(void *ptr)
+{
+    layout_free(ptr);
+    free(ptr);
+}
+
+void code_token_layout(compiler_invocation_t *ci)
+{
+    /* checking if a profile was passed in the first place */
+    if(ci->opt->profile == NULL)
+    {
+        return;
+    }
+
+    /* the profile may be malformed, the invocation lets go of the graph then */
+    layout_t *ly = calloc(1, sizeof(layout_t));
+    code_resource_hold(ci, ly, layout_release);
+    layout_build(ci, ly);
+
+    if(ly->group_cnt == 0)
+    {
+        code_resource_drop(ci, ly);
+        return;
+    }
+
+    layout_profile_load(ci, ly);
+    layout_static_edges(ci, ly);
+    layout_chain_merge(ly);
+
+    /* ordering what is left of the chains */
+    uint64_t *order = calloc(ly->group_cnt, sizeof(uint64_t));
+    uint64_t order_cnt = 0;
+    for(uint64_t c = 0; c < ly->group_cnt; c++)
+    {
+        if(ly->chain[c].head != LAYOUT_NONE)
+        {
+            order[order_cnt++] = c;
+        }
+    }
+
+    layout_sort_ctx = ly;
+    qsort(order, order_cnt, sizeof(uint64_t), layout_chain_compare);
+
+    /* whatever lives in front of the first global label stays there, the groups follow chain by chain */
+    compiler_line_t *line = calloc(ci->line_cnt, sizeof(compiler_line_t));
+    uint64_t line_cnt = ly->group[0].first;
+    memcpy(line, ci->line, line_cnt * sizeof(compiler_line_t));
+
+    for(uint64_t o = 0; o < order_cnt; o++)
+    {
+        for(uint64_t g = ly->chain[order[o]].head; g != LAYOUT_NONE; g = ly->group[g].next)
+        {
+            layout_group_t *group = &(ly->group[g]);
+
+            if((ci->opt->flags & COMPILER_FLAG_REPORT) && line_cnt != group->first)
+            {
+                diag_note(&(ci->line[group->first].token[0]), "moved function with %lu samples\n", group->weight);
+            }
+
+            memcpy(&(line[line_cnt]), &(ci->line[group->first]), (group->last - group->first + 1) * sizeof(compiler_line_t));
+            line_cnt += group->last - group->first + 1;
+        }
+    }
+
+    free(ci->line);
+    ci->line = line;
+    ci->line_cnt = line_cnt;
+    code_line_relink(ci);
+
+    free(order);
+    code_resource_drop(ci, ly);
+}
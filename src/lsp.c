@@ -0,0 +1,526 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2024 cr4zyengineer
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <la64asm/lsp.h>
+#include <la64asm/index.h>
+#include <la64asm/json.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <ctype.h>
+
+#define LSP_METHOD_NOT_FOUND                    -32601
+#define LSP_PARSE_ERROR                         -32700
+
+typedef struct {
+    index_t ix;                             /* what is known about the code base */
+    char *root;                             /* workspace to index once initialized, NULL if none */
+    bool shutdown;                          /* shutdown was requested, exit may exit cleanly */
+} lsp_t;
+
+static bool lsp_read(char **body,
+                     size_t *len)
+{
+    /* headers until an empty line, only the length matters */
+    char line[256];
+    bool have = false;
+
+    *len = 0;
+    while(fgets(line, sizeof(line), stdin) != NULL)
+    {
+        if(line[0] == '\r' || line[0] == '\n')
+        {
+            if(have)
+            {
+                break;
+            }
+
+            continue;
+        }
+
+        if(strncasecmp(line, "Content-Length:", 15) == 0)
+        {
+            *len = strtoull(line + 15, NULL, 10);
+            have = true;
+        }
+    }
+
+    if(!have)
+    {
+        return false;
+    }
+
+    *body = malloc(*len + 1);
+    if(fread(*body, 1, *len, stdin) != *len)
+    {
+        free(*body);
+        return false;
+    }
+
+    (*body)[*len] = '\0';
+    return true;
+}
+
+static void lsp_send(char *buf,
+                     size_t len)
+{
+    printf("Content-Length: %zu\r\n\r\n", len);
+    fwrite(buf, 1, len, stdout);
+    fflush(stdout);
+}
+
+static FILE *lsp_response(json_t *id,
+                          char **buf,
+                          size_t *len)
+{
+    FILE *fp = open_memstream(buf, len);
+    fputs("{\"jsonrpc\":\"2.0\",\"id\":", fp);
+    json_write(fp, id);
+    fputs(",\"result\":", fp);
+    return fp;
+}
+
+static void lsp_finish(FILE *fp,
+                       char **buf,
+                       size_t *len)
+{
+    fputc('}', fp);
+    fclose(fp);
+    lsp_send(*buf, *len);
+    free(*buf);
+}
+
+static void lsp_error(json_t *id,
+                      int code,
+                      const char *msg)
+{
+    char *buf = NULL;
+    size_t len = 0;
+    FILE *fp = open_memstream(&buf, &len);
+
+    fputs("{\"jsonrpc\":\"2.0\",\"id\":", fp);
+    json_write(fp, id);
+    fprintf(fp, ",\"error\":{\"code\":%d,\"message\":", code);
+    json_write_string(fp, msg);
+    fputs("}", fp);
+    lsp_finish(fp, &buf, &len);
+}
+
+static char *lsp_uri_path(const char *uri)
+{
+    if(uri == NULL || strncmp(uri, "file://", 7) != 0)
+    {
+        return NULL;
+    }
+
+    /* percent decoding, the authority is empty for local files */
+    const char *src = uri + 7;
+    char *path = malloc(strlen(src) + 1);
+    size_t n = 0;
+
+    for(; *src != '\0'; src++)
+    {
+        if(src[0] == '%' && isxdigit((unsigned char)src[1]) && isxdigit((unsigned char)src[2]))
+        {
+            char hex[3] = { src[1], src[2], '\0' };
+            path[n++] = strtol(hex, NULL, 16);
+            src += 2;
+        }
+        else
+        {
+            path[n++] = *src;
+        }
+    }
+
+    path[n] = '\0';
+    return path;
+}
+
+static void lsp_write_uri(FILE *fp,
+                          const char *path)
+{
+    fputs("\"file://", fp);
+
+    for(; *path != '\0'; path++)
+    {
+        unsigned char c = *path;
+
+        if(isalnum(c) || strchr("/-._~", c) != NULL)
+        {
+            fputc(c, fp);
+        }
+        else
+        {
+            fprintf(fp, "%%%02X", c);
+        }
+    }
+
+    fputc('"', fp);
+}
+
+static void lsp_write_range(FILE *fp,
+                            uint32_t line,
+                            uint32_t col,
+                            uint32_t len)
+{
+    /* columns are bytes, which are utf-16 units as well as long as the source is ascii */
+    fprintf(fp, "{\"start\":{\"line\":%u,\"character\":%u},\"end\":{\"line\":%u,\"character\":%u}}", line, col, line, col + len);
+}
+
+static void lsp_write_location(FILE *fp,
+                               const char *path,
+                               uint32_t line,
+                               uint32_t col,
+                               uint32_t len)
+{
+    fputs("{\"uri\":", fp);
+    lsp_write_uri(fp, path);
+    fputs(",\"range\":", fp);
+    lsp_write_range(fp, line, col, len);
+    fputc('}', fp);
+}
+
+static index_doc_t *lsp_doc(lsp_t *ls,
+                            json_t *params)
+{
+    char *path = lsp_uri_path(json_string(json_get(json_get(params, "textDocument"), "uri")));
+
+    if(path == NULL)
+    {
+        return NULL;
+    }
+
+    index_doc_t *doc = index_add(&(ls->ix), path);
+    free(path);
+    return doc;
+}
+
+static void lsp_publish(lsp_t *ls,
+                        index_doc_t *doc)
+{
+    index_diag_t *diag = NULL;
+    uint64_t diag_cnt = (doc->text == NULL) ? 0 : index_diagnose(&(ls->ix), doc, &diag);
+
+    char *buf = NULL;
+    size_t len = 0;
+    FILE *fp = open_memstream(&buf, &len);
+
+    fputs("{\"jsonrpc\":\"2.0\",\"method\":\"textDocument/publishDiagnostics\",\"params\":{\"uri\":", fp);
+    lsp_write_uri(fp, doc->path);
+    fputs(",\"diagnostics\":[", fp);
+
+    for(uint64_t i = 0; i < diag_cnt; i++)
+    {
+        fputs((i == 0) ? "{\"range\":" : ",{\"range\":", fp);
+
+        /* errors without a column cover their whole line */
+        if(diag[i].len == 0)
+        {
+            fprintf(fp, "{\"start\":{\"line\":%u,\"character\":0},\"end\":{\"line\":%u,\"character\":0}}", diag[i].line, diag[i].line + 1);
+        }
+        else
+        {
+            lsp_write_range(fp, diag[i].line, diag[i].col, diag[i].len);
+        }
+
+        fputs(",\"severity\":1,\"source\":\"la64asm\",\"message\":", fp);
+        json_write_string(fp, diag[i].msg);
+        fputc('}', fp);
+        free(diag[i].msg);
+    }
+
+    fputs("]}", fp);
+    lsp_finish(fp, &buf, &len);
+    free(diag);
+}
+
+static void lsp_publish_open(lsp_t *ls)
+{
+    /* a definition going away in one file can break every other open file */
+    for(uint64_t i = 0; i < ls->ix.doc_cnt; i++)
+    {
+        if(ls->ix.doc[i]->text != NULL)
+        {
+            lsp_publish(ls, ls->ix.doc[i]);
+        }
+    }
+}
+
+static void lsp_set_text(lsp_t *ls,
+                         index_doc_t *doc,
+                         const char *text)
+{
+    if(doc == NULL || text == NULL)
+    {
+        return;
+    }
+
+    free(doc->text);
+    doc->text = strdup(text);
+    index_update(&(ls->ix), doc, doc->text, strlen(doc->text));
+    lsp_publish_open(ls);
+}
+
+static void lsp_initialize(lsp_t *ls,
+                           json_t *id,
+                           json_t *params)
+{
+    /* the workspace is indexed once the client got its answer */
+    const char *uri = json_string(json_get(params, "rootUri"));
+    json_t *folders = json_get(params, "workspaceFolders");
+
+    if(uri == NULL && folders != NULL && folders->type == JSON_ARRAY && folders->child_cnt > 0)
+    {
+        uri = json_string(json_get(&(folders->child[0]), "uri"));
+    }
+
+    free(ls->root);
+    ls->root = (uri != NULL) ? lsp_uri_path(uri) : NULL;
+
+    if(ls->root == NULL && json_string(json_get(params, "rootPath")) != NULL)
+    {
+        ls->root = strdup(json_string(json_get(params, "rootPath")));
+    }
+
+    char *buf = NULL;
+    size_t len = 0;
+    FILE *fp = lsp_response(id, &buf, &len);
+    fputs("{\"capabilities\":{\"textDocumentSync\":1,\"definitionProvider\":true,\"referencesProvider\":true},"
+          "\"serverInfo\":{\"name\":\"la64asm\"}}", fp);
+    lsp_finish(fp, &buf, &len);
+}
+
+static void lsp_locations(lsp_t *ls,
+                          json_t *id,
+                          json_t *params,
+                          bool references)
+{
+    index_doc_t *doc = lsp_doc(ls, params);
+    json_t *pos = json_get(params, "position");
+    index_symbol_t *sym = (doc == NULL) ? NULL : index_symbol_at(doc, json_number(json_get(pos, "line"), 0), json_number(json_get(pos, "character"), 0));
+    bool decl = !references || json_number(json_get(json_get(params, "context"), "includeDeclaration"), 1) != 0;
+
+    char *buf = NULL;
+    size_t len = 0;
+    FILE *fp = lsp_response(id, &buf, &len);
+
+    if(sym == NULL)
+    {
+        fputs("null", fp);
+        lsp_finish(fp, &buf, &len);
+        return;
+    }
+
+    fputc('[', fp);
+
+    if(sym->kind == INDEX_SYMBOL_INCLUDE)
+    {
+        /* the definition of an include is the file itself */
+        if(!references)
+        {
+            lsp_write_location(fp, sym->name, 0, 0, 0);
+        }
+    }
+    else
+    {
+        /* names are interned, so every document is scanned comparing pointers */
+        bool first = true;
+        for(uint64_t d = 0; d < ls->ix.doc_cnt; d++)
+        {
+            index_doc_t *other = ls->ix.doc[d];
+
+            for(uint64_t i = 0; i < other->sym_cnt; i++)
+            {
+                index_symbol_t *s = &(other->sym[i]);
+                bool def = (s->flags & INDEX_FLAG_DEF) != 0;
+
+                if(s->name != sym->name || s->kind == INDEX_SYMBOL_INCLUDE ||
+                   (references ? (def && !decl) : !def))
+                {
+                    continue;
+                }
+
+                if(!first)
+                {
+                    fputc(',', fp);
+                }
+
+                lsp_write_location(fp, other->path, s->line, s->col, s->len);
+                first = false;
+            }
+        }
+    }
+
+    fputc(']', fp);
+    lsp_finish(fp, &buf, &len);
+}
+
+static void lsp_did_close(lsp_t *ls,
+                          json_t *params)
+{
+    index_doc_t *doc = lsp_doc(ls, params);
+
+    if(doc == NULL)
+    {
+        return;
+    }
+
+    /* back to what is on disk, the editor no longer owns the file */
+    free(doc->text);
+    doc->text = NULL;
+    lsp_publish(ls, doc);
+
+    if(!index_reload(&(ls->ix), doc))
+    {
+        index_remove(&(ls->ix), doc);
+    }
+
+    lsp_publish_open(ls);
+}
+
+static void lsp_watched_files(lsp_t *ls,
+                              json_t *params)
+{
+    json_t *changes = json_get(params, "changes");
+
+    for(uint64_t i = 0; changes != NULL && changes->type == JSON_ARRAY && i < changes->child_cnt; i++)
+    {
+        char *path = lsp_uri_path(json_string(json_get(&(changes->child[i]), "uri")));
+        char *real = (path == NULL) ? NULL : realpath(path, NULL);
+        index_doc_t *doc = index_doc(&(ls->ix), (real != NULL) ? real : (path != NULL) ? path : "");
+
+        /* files open in the editor are what the editor says they are */
+        if(doc == NULL && real != NULL)
+        {
+            index_add(&(ls->ix), real);
+        }
+        else if(doc != NULL && doc->text == NULL && !index_reload(&(ls->ix), doc))
+        {
+            index_remove(&(ls->ix), doc);
+        }
+
+        free(real);
+        free(path);
+    }
+
+    lsp_publish_open(ls);
+}
+
+int lsp_serve(void)
+{
+    lsp_t ls = { 0 };
+    char *body = NULL;
+    size_t len = 0;
+    int status = EXIT_FAILURE;
+
+    /* one request or notification after the other, until the client says exit */
+    while(lsp_read(&body, &len))
+    {
+        json_t *msg = json_parse(body, len);
+        free(body);
+
+        if(msg == NULL)
+        {
+            lsp_error(NULL, LSP_PARSE_ERROR, "malformed message");
+            continue;
+        }
+
+        const char *method = json_string(json_get(msg, "method"));
+        json_t *id = json_get(msg, "id");
+        json_t *params = json_get(msg, "params");
+        json_t *doc = json_get(params, "textDocument");
+
+        if(method == NULL)
+        {
+            /* answers to requests the server never makes */
+        }
+        else if(strcmp(method, "initialize") == 0)
+        {
+            lsp_initialize(&ls, id, params);
+
+            if(ls.root != NULL)
+            {
+                index_workspace(&(ls.ix), ls.root);
+            }
+        }
+        else if(strcmp(method, "textDocument/didOpen") == 0)
+        {
+            lsp_set_text(&ls, lsp_doc(&ls, params), json_string(json_get(doc, "text")));
+        }
+        else if(strcmp(method, "textDocument/didChange") == 0)
+        {
+            /* the whole text is sent every time, the last change is what counts */
+            json_t *changes = json_get(params, "contentChanges");
+
+            if(changes != NULL && changes->type == JSON_ARRAY && changes->child_cnt > 0)
+            {
+                lsp_set_text(&ls, lsp_doc(&ls, params), json_string(json_get(&(changes->child[changes->child_cnt - 1]), "text")));
+            }
+        }
+        else if(strcmp(method, "textDocument/didClose") == 0)
+        {
+            lsp_did_close(&ls, params);
+        }
+        else if(strcmp(method, "workspace/didChangeWatchedFiles") == 0)
+        {
+            lsp_watched_files(&ls, params);
+        }
+        else if(strcmp(method, "textDocument/definition") == 0)
+        {
+            lsp_locations(&ls, id, params, false);
+        }
+        else if(strcmp(method, "textDocument/references") == 0)
+        {
+            lsp_locations(&ls, id, params, true);
+        }
+        else if(strcmp(method, "shutdown") == 0)
+        {
+            char *buf = NULL;
+            size_t buf_len = 0;
+            FILE *fp = lsp_response(id, &buf, &buf_len);
+            fputs("null", fp);
+            lsp_finish(fp, &buf, &buf_len);
+            ls.shutdown = true;
+        }
+        else if(strcmp(method, "exit") == 0)
+        {
+            status = ls.shutdown ? EXIT_SUCCESS : EXIT_FAILURE;
+            json_free(msg);
+            free(msg);
+            break;
+        }
+        else if(id != NULL)
+        {
+            lsp_error(id, LSP_METHOD_NOT_FOUND, "method not supported");
+        }
+
+        json_free(msg);
+        free(msg);
+    }
+
+    index_free(&(ls.ix));
+    free(ls.root);
+    return status;
+}
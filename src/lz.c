@@ -0,0 +1,407 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2024 cr4zyengineer
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <la64asm/lz.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define LZ_HASH_BITS                            14
+#define LZ_OFFSET_MAX                           0xFFFF
+#define LZ_SKIP_SHIFT                           6
+
+#define LZ_STATE_HEADER                         0
+#define LZ_STATE_LENGTH                         1
+#define LZ_STATE_BLOCK                          2
+#define LZ_STATE_DONE                           3
+#define LZ_STATE_ERROR                          4
+
+static inline uint32_t lz_read32(const uint8_t *p)
+{
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static inline uint32_t lz_hash(uint32_t v)
+{
+    return (v * 2654435761u) >> (32 - LZ_HASH_BITS);
+}
+
+size_t la64_lz_bound(size_t len)
+{
+    /* incompressible input grows by a length byte every 255 literals */
+    return len + len / 255 + 16;
+}
+
+static uint8_t *lz_length(uint8_t *op,
+                          size_t len)
+{
+    for(; len >= 255; len -= 255)
+    {
+        *op++ = 255;
+    }
+
+    *op++ = len;
+    return op;
+}
+
+static uint8_t *lz_sequence(uint8_t *op,
+                            const uint8_t *lit,
+                            size_t lit_len,
+                            size_t off,
+                            size_t match_len)
+{
+    /* the nibbles saturate at 15, the rest follows in bytes */
+    size_t ml = (match_len == 0) ? 0 : match_len - LA64_LZ_MIN_MATCH;
+    uint8_t *token = op++;
+    *token = ((lit_len < 15) ? lit_len : 15) << 4 | ((ml < 15) ? ml : 15);
+
+    if(lit_len >= 15)
+    {
+        op = lz_length(op, lit_len - 15);
+    }
+
+    memcpy(op, lit, lit_len);
+    op += lit_len;
+
+    if(match_len == 0)
+    {
+        return op;
+    }
+
+    *op++ = off & 0xFF;
+    *op++ = off >> 8;
+
+    if(ml >= 15)
+    {
+        op = lz_length(op, ml - 15);
+    }
+
+    return op;
+}
+
+size_t la64_lz_compress_block(const uint8_t *src,
+                              size_t len,
+                              uint8_t *dst,
+                              size_t cap)
+{
+    /* positions plus one, so zero means nothing seen yet */
+    uint32_t *table = calloc(1 << LZ_HASH_BITS, sizeof(uint32_t));
+    const uint8_t *anchor = src;
+    uint8_t *op = dst;
+    size_t i = 0;
+    size_t miss = 0;
+
+    if(cap < la64_lz_bound(len))
+    {
+        free(table);
+        return 0;
+    }
+
+    while(i + LA64_LZ_MIN_MATCH <= len)
+    {
+        uint32_t v = lz_read32(&src[i]);
+        uint32_t h = lz_hash(v);
+        size_t cand = table[h];
+        table[h] = i + 1;
+
+        if(cand == 0 || i - (cand - 1) > LZ_OFFSET_MAX || lz_read32(&src[cand - 1]) != v)
+        {
+            /* data that does not repeat is skipped faster and faster */
+            i += 1 + (miss++ >> LZ_SKIP_SHIFT);
+            continue;
+        }
+
+        cand--;
+        size_t match_len = LA64_LZ_MIN_MATCH;
+        while(i + match_len < len && src[cand + match_len] == src[i + match_len])
+        {
+            match_len++;
+        }
+
+        op = lz_sequence(op, anchor, &src[i] - anchor, i - cand, match_len);
+        i += match_len;
+        anchor = &src[i];
+        miss = 0;
+
+        /* the end of a match is often the start of the next */
+        if(i >= 2 && i + LA64_LZ_MIN_MATCH <= len)
+        {
+            table[lz_hash(lz_read32(&src[i - 2]))] = i - 1;
+        }
+    }
+
+    op = lz_sequence(op, anchor, &src[len] - anchor, 0, 0);
+
+    free(table);
+    return op - dst;
+}
+
+static bool lz_read_length(const uint8_t **ip,
+                           const uint8_t *end,
+                           size_t *len)
+{
+    uint8_t b;
+
+    do
+    {
+        if(*ip >= end)
+        {
+            return false;
+        }
+
+        b = *(*ip)++;
+        *len += b;
+    }
+    while(b == 255);
+
+    return true;
+}
+
+bool la64_lz_decompress_block(const uint8_t *src,
+                              size_t len,
+                              uint8_t *dst,
+                              size_t dst_len)
+{
+    const uint8_t *ip = src;
+    const uint8_t *iend = src + len;
+    uint8_t *op = dst;
+    uint8_t *oend = dst + dst_len;
+
+    /* every length and offset is checked, a corrupt block never writes outside dst */
+    while(ip < iend)
+    {
+        uint8_t token = *ip++;
+        size_t lit = token >> 4;
+
+        if(lit == 15 && !lz_read_length(&ip, iend, &lit))
+        {
+            return false;
+        }
+
+        if(lit > (size_t)(iend - ip) || lit > (size_t)(oend - op))
+        {
+            return false;
+        }
+
+        memcpy(op, ip, lit);
+        op += lit;
+        ip += lit;
+
+        if(ip == iend)
+        {
+            break;
+        }
+
+        if(iend - ip < 2)
+        {
+            return false;
+        }
+
+        size_t off = ip[0] | (ip[1] << 8);
+        size_t match_len = token & 15;
+        ip += 2;
+
+        if(match_len == 15 && !lz_read_length(&ip, iend, &match_len))
+        {
+            return false;
+        }
+
+        match_len += LA64_LZ_MIN_MATCH;
+
+        if(off == 0 || off > (size_t)(op - dst) || match_len > (size_t)(oend - op))
+        {
+            return false;
+        }
+
+        /* overlapping matches repeat their first off bytes, zero runs are the common case */
+        if(off == 1)
+        {
+            memset(op, op[-1], match_len);
+        }
+        else if(off >= match_len)
+        {
+            memcpy(op, op - off, match_len);
+        }
+        else
+        {
+            for(size_t done = 0; done < match_len; done += off)
+            {
+                size_t n = (match_len - done < off) ? match_len - done : off;
+                memcpy(op + done, op + done - off, n);
+            }
+        }
+
+        op += match_len;
+    }
+
+    return op == oend;
+}
+
+void la64_lz_stream_init(la64_lz_stream_t *ls)
+{
+    memset(ls, 0, sizeof(la64_lz_stream_t));
+    ls->state = LZ_STATE_HEADER;
+    ls->need = sizeof(la64_lz_header_t);
+}
+
+static size_t lz_stream_block_len(la64_lz_stream_t *ls)
+{
+    uint64_t left = ls->hdr.size - ls->out;
+    return (left < ls->hdr.block_size) ? left : ls->hdr.block_size;
+}
+
+static void lz_stream_next(la64_lz_stream_t *ls)
+{
+    /* every block starts with its length, none follows the last */
+    ls->state = (ls->out == ls->hdr.size) ? LZ_STATE_DONE : LZ_STATE_LENGTH;
+    ls->need = sizeof(uint32_t);
+    ls->got = 0;
+}
+
+static bool lz_stream_header(la64_lz_stream_t *ls)
+{
+    la64_lz_header_t *hdr = &(ls->hdr);
+
+    if(memcmp(hdr->magic, LA64_LZ_MAGIC, sizeof(hdr->magic)) != 0 ||
+       hdr->version != LA64_LZ_VERSION ||
+       hdr->block_size == 0 ||
+       hdr->block_size >= LA64_LZ_BLOCK_STORED)
+    {
+        return false;
+    }
+
+    ls->in = malloc(la64_lz_bound(hdr->block_size));
+    ls->buf = malloc(hdr->block_size);
+    lz_stream_next(ls);
+
+    return ls->in != NULL && ls->buf != NULL;
+}
+
+static bool lz_stream_block(la64_lz_stream_t *ls,
+                            const uint8_t *packed,
+                            la64_lz_sink_fn sink,
+                            void *ctx)
+{
+    size_t len = lz_stream_block_len(ls);
+
+    /* stored blocks go out as they came in */
+    if(ls->packed & LA64_LZ_BLOCK_STORED)
+    {
+        sink(packed, len, ctx);
+    }
+    else if(la64_lz_decompress_block(packed, ls->need, ls->buf, len))
+    {
+        sink(ls->buf, len, ctx);
+    }
+    else
+    {
+        return false;
+    }
+
+    ls->out += len;
+    lz_stream_next(ls);
+    return true;
+}
+
+int la64_lz_stream_feed(la64_lz_stream_t *ls,
+                        const void *data,
+                        size_t len,
+                        la64_lz_sink_fn sink,
+                        void *ctx)
+{
+    const uint8_t *ip = data;
+    const uint8_t *iend = ip + len;
+
+    while(ls->state != LZ_STATE_DONE && ls->state != LZ_STATE_ERROR && ip < iend)
+    {
+        /* whole blocks are inflated right out of the input, only pieces are collected first */
+        if(ls->state == LZ_STATE_BLOCK && ls->got == 0 && (size_t)(iend - ip) >= ls->need)
+        {
+            ip += ls->need;
+
+            if(!lz_stream_block(ls, ip - ls->need, sink, ctx))
+            {
+                ls->state = LZ_STATE_ERROR;
+            }
+
+            continue;
+        }
+
+        uint8_t *part = (ls->state == LZ_STATE_HEADER) ? (uint8_t*)&(ls->hdr) :
+                        (ls->state == LZ_STATE_LENGTH) ? (uint8_t*)&(ls->packed) : ls->in;
+        size_t n = (size_t)(iend - ip) < ls->need - ls->got ? (size_t)(iend - ip) : ls->need - ls->got;
+
+        memcpy(part + ls->got, ip, n);
+        ls->got += n;
+        ip += n;
+
+        if(ls->got < ls->need)
+        {
+            continue;
+        }
+
+        if(ls->state == LZ_STATE_HEADER)
+        {
+            ls->state = lz_stream_header(ls) ? ls->state : LZ_STATE_ERROR;
+        }
+        else if(ls->state == LZ_STATE_LENGTH)
+        {
+            /* a block is never bigger than the bound of what it inflates to */
+            uint32_t size = ls->packed & ~LA64_LZ_BLOCK_STORED;
+            bool stored = (ls->packed & LA64_LZ_BLOCK_STORED) != 0;
+
+            if(size > la64_lz_bound(ls->hdr.block_size) || (stored && size != lz_stream_block_len(ls)))
+            {
+                ls->state = LZ_STATE_ERROR;
+                continue;
+            }
+
+            ls->state = LZ_STATE_BLOCK;
+            ls->need = size;
+            ls->got = 0;
+        }
+        else if(!lz_stream_block(ls, ls->in, sink, ctx))
+        {
+            ls->state = LZ_STATE_ERROR;
+        }
+    }
+
+    /* trailing bytes behind the last block mean it is not what it claims to be */
+    if(ls->state == LZ_STATE_ERROR || (ls->state == LZ_STATE_DONE && ip < iend))
+    {
+        ls->state = LZ_STATE_ERROR;
+        return LA64_LZ_ERROR;
+    }
+
+    return (ls->state == LZ_STATE_DONE) ? LA64_LZ_DONE : LA64_LZ_MORE;
+}
+
+void la64_lz_stream_free(la64_lz_stream_t *ls)
+{
+    free(ls->in);
+    free(ls->buf);
+    ls->in = NULL;
+    ls->buf = NULL;
+}
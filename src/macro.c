@@ -23,42 +23,508 @@
  */
 
 #include <la64asm/macro.h>
+#include <la64asm/code.h>
+#include <la64asm/diag.h>
+#include <la64asm/intern.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <stdint.h>
+#include <stdbool.h>
+#include <ctype.h>
+#include <lautils/parser.h>
+
+#define MACRO_EXPAND_MAX_DEPTH                  64
 
 typedef struct {
-    const char *name;
-    const char *value;
-} compiler_macro_t;
+    compiler_line_t *line;                  /* lines expanded so far */
+    uint64_t line_cnt;                      /* count of lines */
+    uint64_t line_cap;                      /* capacity of the line array */
+} macro_buffer_t;
+
+static compiler_line_t *macro_buffer_push(macro_buffer_t *mb)
+{
+    /* growing the buffer by doubling it */
+    if(mb->line_cnt == mb->line_cap)
+    {
+        mb->line_cap = (mb->line_cap == 0) ? 64 : mb->line_cap * 2;
+        mb->line = realloc(mb->line, mb->line_cap * sizeof(compiler_line_t));
+    }
+
+    return &(mb->line[mb->line_cnt++]);
+}
+
+static void macro_line_drop(compiler_line_t *line,
+                            uint64_t first,
+                            uint64_t last,
+                            bool owned)
+{
+    /* lines that do not make it into the output are freed, if they are ours to free */
+    for(uint64_t i = first; owned && i <= last; i++)
+    {
+        code_line_free(&(line[i]));
+    }
+}
+
+static compiler_macro_t *macro_lookup(compiler_invocation_t *ci,
+                                      const char *name,
+                                      bool body)
+{
+    /* macro names are interned, a name never interned cannot be a macro */
+    name = intern_find(name);
+
+    if(name == NULL)
+    {
+        return NULL;
+    }
+
+    for(uint64_t i = 0; i < ci->macro_cnt; i++)
+    {
+        if((ci->macro[i].body != NULL) == body &&
+           ci->macro[i].name == name)
+        {
+            return &(ci->macro[i]);
+        }
+    }
+
+    return NULL;
+}
+
+static uint64_t macro_block_end(compiler_line_t *line,
+                                uint64_t line_cnt,
+                                uint64_t start,
+                                compiler_line_type_t begin,
+                                compiler_line_type_t end)
+{
+    /* finding the matching end of a block, blocks of the same kind nest */
+    uint64_t depth = 0;
+    for(uint64_t i = start; i < line_cnt; i++)
+    {
+        if(line[i].type == begin)
+        {
+            depth++;
+        }
+        else if(line[i].type == end && --depth == 0)
+        {
+            return i;
+        }
+    }
+
+    diag_error(&(line[start].token[0]), "missing end of \"%s\" block\n", line[start].token[0].str);
+    return line_cnt;
+}
+
+static uint64_t macro_rept_count(compiler_invocation_t *ci,
+                                 compiler_line_t *cl)
+{
+    if(cl->token_cnt != 2)
+    {
+        diag_error(&(cl->token[0]), ".rept takes exactly one count\n");
+    }
+
+    /* the count may be a %define% */
+    const char *str = cl->token[1].str;
+    compiler_macro_t *cm = macro_lookup(ci, str, false);
+    if(cm != NULL)
+    {
+        str = cm->value;
+    }
+
+    parser_return_t pr = parse_value_from_string(str);
+
+    if(pr.type == laParserValueTypeString ||
+       pr.type == laParserValueTypeBuffer)
+    {
+        diag_error(&(cl->token[1]), "illegal repeat count \"%s\"\n", cl->token[1].str);
+    }
+
+    return pr.value;
+}
+
+static inline bool macro_is_ident(char c)
+{
+    /* the same characters expressions take for a label */
+    return isalnum((unsigned char)c) || c == '_' || c == '.';
+}
+
+static char *macro_substitute(const char *str,
+                              char **param,
+                              compiler_token_t *arg,
+                              uint64_t param_cnt,
+                              const char *unique)
+{
+    /* parameters are replaced wherever they stand as a name of their own, \@ by the expansion number */
+    size_t cap = strlen(str) + 1;
+    size_t len = 0;
+    char *res = malloc(cap);
+    bool changed = false;
+
+    for(const char *p = str; *p != '\0';)
+    {
+        const char *rep = NULL;
+        size_t skip = 1;
+
+        if(*p == '"' || *p == '\'')
+        {
+            /* strings and characters are left alone */
+            const char *q = p + 1;
+            for(; *q != '\0' && *q != *p; q += (*q == '\\' && q[1] != '\0') ? 2 : 1);
+            skip = (*q == '\0') ? q - p : q - p + 1;
+        }
+        else if(p[0] == '\\' && p[1] == '@' && unique != NULL)
+        {
+            rep = unique;
+            skip = 2;
+        }
+        else if(macro_is_ident(*p))
+        {
+            const char *q = p;
+            for(; macro_is_ident(*q); q++);
+            skip = q - p;
+
+            for(uint64_t i = 0; i < param_cnt; i++)
+            {
+                if(strlen(param[i]) == skip && strncmp(param[i], p, skip) == 0)
+                {
+                    rep = arg[i].str;
+                    break;
+                }
+            }
+        }
+
+        size_t n = (rep == NULL) ? skip : strlen(rep);
+
+        if(len + n + 1 > cap)
+        {
+            cap = (len + n + 1) * 2;
+            res = realloc(res, cap);
+        }
+
+        memcpy(&res[len], (rep == NULL) ? p : rep, n);
+        len += n;
+        p += skip;
+        changed |= (rep != NULL);
+    }
+
+    res[len] = '\0';
+
+    if(!changed)
+    {
+        free(res);
+        return NULL;
+    }
+
+    return res;
+}
+
+static bool macro_lines_unique(compiler_line_t *line,
+                               uint64_t line_cnt)
+{
+    /* only \@ outside of nested repeat blocks belongs to this expansion */
+    uint64_t depth = 0;
+    for(uint64_t i = 0; i < line_cnt; i++)
+    {
+        depth += (line[i].type == COMPILER_LINE_TYPE_REPT);
+        depth -= (line[i].type == COMPILER_LINE_TYPE_ENDR && depth > 0);
+
+        for(uint64_t a = 0; depth == 0 && a < line[i].token_cnt; a++)
+        {
+            if(strstr(line[i].token[a].str, "\\@") != NULL)
+            {
+                return true;
+            }
+        }
+    }
+
+    return false;
+}
+
+static compiler_line_t *macro_lines_copy(compiler_invocation_t *ci,
+                                         compiler_line_t *line,
+                                         uint64_t line_cnt,
+                                         char **param,
+                                         compiler_token_t *arg,
+                                         uint64_t param_cnt)
+{
+    /* every copy that uses \@ takes the next number, nested repeat blocks number their own copies */
+    char unique[24] = { 0 };
+    if(macro_lines_unique(line, line_cnt))
+    {
+        snprintf(unique, sizeof(unique), "%lu", ci->macro_unique++);
+    }
+
+    compiler_line_t *sub = calloc(line_cnt, sizeof(compiler_line_t));
+    uint64_t depth = 0;
+    for(uint64_t i = 0; i < line_cnt; i++)
+    {
+        code_line_copy(&(sub[i]), &(line[i]));
+        depth += (line[i].type == COMPILER_LINE_TYPE_REPT);
+
+        for(uint64_t a = 0; a < sub[i].token_cnt; a++)
+        {
+            char *str = macro_substitute(sub[i].token[a].str, param, arg, param_cnt, (depth == 0 && unique[0] != '\0') ? unique : NULL);
+
+            if(str != NULL)
+            {
+                free(sub[i].token[a].str);
+                sub[i].token[a].str = str;
+            }
+        }
+
+        depth -= (line[i].type == COMPILER_LINE_TYPE_ENDR && depth > 0);
+    }
+
+    return sub;
+}
+
+static bool macro_expand(compiler_invocation_t *ci, compiler_line_t *line, uint64_t line_cnt, macro_buffer_t *out, uint64_t depth, bool owned);
+
+static bool macro_invoke(compiler_invocation_t *ci,
+                         compiler_macro_t *cm,
+                         compiler_line_t *cl,
+                         macro_buffer_t *out,
+                         uint64_t depth)
+{
+    if(cl->token_cnt - 1 != cm->param_cnt)
+    {
+        diag_error(&(cl->token[0]), "macro \"%s\" takes %lu arguments but %lu were given\n", cm->name, cm->param_cnt, cl->token_cnt - 1);
+    }
+
+    /* building the memoization key out of the arguments */
+    size_t len = 1;
+    for(uint64_t a = 1; a < cl->token_cnt; a++)
+    {
+        len += strlen(cl->token[a].str) + 1;
+    }
+
+    char *key = calloc(len, 1);
+    for(uint64_t a = 1; a < cl->token_cnt; a++)
+    {
+        strcat(key, cl->token[a].str);
+        strcat(key, "\x1f");
+    }
+
+    /* identical arguments expand identically, unless the expansion makes up labels of its own */
+    for(uint64_t m = 0; !cm->unique && m < cm->memo_cnt; m++)
+    {
+        if(strcmp(cm->memo[m].key, key) == 0)
+        {
+            for(uint64_t a = 0; a < cm->memo[m].line_cnt; a++)
+            {
+                code_line_copy(macro_buffer_push(out), &(cm->memo[m].line[a]));
+            }
+
+            free(key);
+            return false;
+        }
+    }
+
+    /* substituting parameters in a copy of the body, the body may use other macros and repeat blocks */
+    compiler_line_t *sub = macro_lines_copy(ci, cm->body, cm->body_cnt, cm->param, &(cl->token[1]), cm->param_cnt);
+    macro_buffer_t mb = { 0 };
+    cm->unique |= macro_lines_unique(cm->body, cm->body_cnt);
+    cm->unique |= macro_expand(ci, sub, cm->body_cnt, &mb, depth + 1, true);
+    free(sub);
+
+    if(cm->unique)
+    {
+        for(uint64_t a = 0; a < mb.line_cnt; a++)
+        {
+            *macro_buffer_push(out) = mb.line[a];
+        }
+
+        free(mb.line);
+        free(key);
+        return true;
+    }
+
+    cm->memo = realloc(cm->memo, (cm->memo_cnt + 1) * sizeof(compiler_macro_expansion_t));
+    cm->memo[cm->memo_cnt].key = key;
+    cm->memo[cm->memo_cnt].line = mb.line;
+    cm->memo[cm->memo_cnt].line_cnt = mb.line_cnt;
+    cm->memo_cnt++;
+
+    for(uint64_t a = 0; a < mb.line_cnt; a++)
+    {
+        code_line_copy(macro_buffer_push(out), &(mb.line[a]));
+    }
+
+    return false;
+}
+
+static bool macro_expand(compiler_invocation_t *ci,
+                         compiler_line_t *line,
+                         uint64_t line_cnt,
+                         macro_buffer_t *out,
+                         uint64_t depth,
+                         bool owned)
+{
+    if(depth > MACRO_EXPAND_MAX_DEPTH)
+    {
+        diag_error(&(line[0].token[0]), "macro expansion nested too deep\n");
+    }
+
+    /* telling the caller if anything expanded made up labels, such expansions cannot be reused */
+    bool unique = false;
+
+    for(uint64_t i = 0; i < line_cnt; i++)
+    {
+        compiler_line_t *cl = &(line[i]);
+        compiler_macro_t *cm = NULL;
+
+        switch(cl->type)
+        {
+            case COMPILER_LINE_TYPE_MACROBEGIN:
+            {
+                /* definitions were collected already */
+                uint64_t end = macro_block_end(line, line_cnt, i, COMPILER_LINE_TYPE_MACROBEGIN, COMPILER_LINE_TYPE_MACROEND);
+                macro_line_drop(line, i, end, owned);
+                i = end;
+                continue;
+            }
+            case COMPILER_LINE_TYPE_REPT:
+            {
+                uint64_t end = macro_block_end(line, line_cnt, i, COMPILER_LINE_TYPE_REPT, COMPILER_LINE_TYPE_ENDR);
+                uint64_t count = macro_rept_count(ci, cl);
+
+                for(uint64_t r = 0; r < count; r++)
+                {
+                    /* each round numbers its \@ anew */
+                    if(macro_lines_unique(&(line[i + 1]), end - i - 1))
+                    {
+                        compiler_line_t *sub = macro_lines_copy(ci, &(line[i + 1]), end - i - 1, NULL, NULL, 0);
+                        macro_expand(ci, sub, end - i - 1, out, depth + 1, true);
+                        free(sub);
+                        unique = true;
+                    }
+                    else
+                    {
+                        unique |= macro_expand(ci, &(line[i + 1]), end - i - 1, out, depth + 1, false);
+                    }
+                }
+
+                macro_line_drop(line, i, end, owned);
+                i = end;
+                continue;
+            }
+            case COMPILER_LINE_TYPE_MACROEND:
+            case COMPILER_LINE_TYPE_ENDR:
+                diag_error(&(cl->token[0]), "\"%s\" without a beginning\n", cl->token[0].str);
+                continue;
+            case COMPILER_LINE_TYPE_ASM:
+                cm = macro_lookup(ci, cl->token[0].str, true);
+                break;
+            default:
+                break;
+        }
+
+        if(cm != NULL)
+        {
+            unique |= macro_invoke(ci, cm, cl, out, depth);
+            macro_line_drop(line, i, i, owned);
+        }
+        else if(owned)
+        {
+            *macro_buffer_push(out) = *cl;
+        }
+        else
+        {
+            code_line_copy(macro_buffer_push(out), cl);
+        }
+    }
+
+    return unique;
+}
 
+/*
+ * %macro% name p1, p2 ... %endmacro% bodies replace every parameter that
+ * stands as a name of its own, so "tbl+8" uses the argument for tbl too,
+ * strings are left alone. \@ in a %macro% body or a .rept block becomes a
+ * number unique to each expansion, so ".loop\@:" gives every expansion a
+ * local label of its own. inside nested .rept blocks \@ belongs to the
+ * innermost one.
+ */
 void code_token_macro(compiler_invocation_t *ci)
 {
     /* count the amount of macros */
     uint64_t c = 0;
     for(uint64_t i = 0; i < ci->line_cnt; i++)
     {
-        if(ci->line[i].type == COMPILER_LINE_TYPE_MACRODEF)
+        if(ci->line[i].type == COMPILER_LINE_TYPE_MACRODEF ||
+           ci->line[i].type == COMPILER_LINE_TYPE_MACROBEGIN)
         {
             c++;
         }
     }
 
     /* allocating */
-    compiler_macro_t *cm = calloc(c, sizeof(compiler_macro_t));
+    ci->macro = calloc(c, sizeof(compiler_macro_t));
+    ci->macro_cnt = 0;
 
     /* adding stuff */
-    c = 0;
     for(uint64_t i = 0; i < ci->line_cnt; i++)
     {
-        if(ci->line[i].type == COMPILER_LINE_TYPE_MACRODEF)
+        compiler_line_t *cl = &(ci->line[i]);
+
+        if(cl->type == COMPILER_LINE_TYPE_MACRODEF)
         {
-            cm[c].name = ci->line[i].token[1].str;
-            cm[c].value = ci->line[i].token[2].str;
-            c++;
+            ci->macro[ci->macro_cnt].name = intern(cl->token[1].str);
+            ci->macro[ci->macro_cnt++].value = strdup(cl->token[2].str);
+        }
+        else if(cl->type == COMPILER_LINE_TYPE_MACROBEGIN)
+        {
+            if(cl->token_cnt < 2)
+            {
+                diag_error(&(cl->token[0]), "%%macro%% without a name\n");
+            }
+
+            if(macro_lookup(ci, cl->token[1].str, true) != NULL)
+            {
+                diag_error(&(cl->token[1]), "duplicated macro \"%s\"\n", cl->token[1].str);
+            }
+
+            uint64_t end = macro_block_end(ci->line, ci->line_cnt, i, COMPILER_LINE_TYPE_MACROBEGIN, COMPILER_LINE_TYPE_MACROEND);
+
+            for(uint64_t a = i + 1; a < end; a++)
+            {
+                if(ci->line[a].type == COMPILER_LINE_TYPE_MACROBEGIN)
+                {
+                    diag_error(&(ci->line[a].token[0]), "nested macro definitions are not supported\n");
+                }
+            }
+
+            compiler_macro_t *cm = &(ci->macro[ci->macro_cnt++]);
+            cm->name = intern(cl->token[1].str);
+
+            /* parameters are the remaining tokens */
+            cm->param_cnt = cl->token_cnt - 2;
+            cm->param = calloc(cm->param_cnt, sizeof(char*));
+            for(uint64_t a = 0; a < cm->param_cnt; a++)
+            {
+                cm->param[a] = strdup(cl->token[a + 2].str);
+            }
+
+            /* tokenized once, the body is only ever copied, it is never NULL so empty bodies are still macros */
+            cm->body_cnt = end - i - 1;
+            cm->body = calloc(cm->body_cnt + 1, sizeof(compiler_line_t));
+            for(uint64_t a = 0; a < cm->body_cnt; a++)
+            {
+                code_line_copy(&(cm->body[a]), &(ci->line[i + 1 + a]));
+            }
+
+            i = end;
         }
     }
 
+    /* expanding macro invocations and repeat blocks into a new line array */
+    macro_buffer_t mb = { 0 };
+    macro_expand(ci, ci->line, ci->line_cnt, &mb, 0, true);
+
+    free(ci->line);
+    ci->line = mb.line;
+    ci->line_cnt = mb.line_cnt;
+    code_line_relink(ci);
+
     /* now replacing */
     for(uint64_t i = 0; i < ci->line_cnt; i++)
     {
@@ -66,15 +532,14 @@ void code_token_macro(compiler_invocation_t *ci)
         {
             for(uint64_t a = 0; a < ci->line[i].token_cnt; a++)
             {
-                for(uint64_t b = 0; b < c; b++)
+                compiler_macro_t *cm = macro_lookup(ci, ci->line[i].token[a].str, false);
+
+                if(cm != NULL)
                 {
-                    if(strcmp(ci->line[i].token[a].str, cm[b].name) == 0)
-                    {
-                        free(ci->line[i].token[a].str);
-                        ci->line[i].token[a].str = strdup(cm[b].value);
-                    }
+                    free(ci->line[i].token[a].str);
+                    ci->line[i].token[a].str = strdup(cm->value);
                 }
             }
         }
     }
-}
\ No newline at end of file
+}
@@ -26,33 +26,270 @@
 #include <stdlib.h>
 #include <unistd.h>
 #include <string.h>
+#include <ctype.h>
 #include <la64asm/compile.h>
+#include <la64asm/batch.h>
+#include <la64asm/watch.h>
+#include <la64asm/lsp.h>
+
+typedef struct {
+    const char *name;
+    uint64_t flags;
+} option_entry_t;
+
+static option_entry_t option_table[] = {
+    { .name = "-O", .flags = COMPILER_FLAG_STRENGTH_REDUCE | COMPILER_FLAG_BRANCH_OPT | COMPILER_FLAG_TAIL_CALL },
+    { .name = "-Rpass", .flags = COMPILER_FLAG_REPORT },
+    { .name = "-fstrength-reduce", .flags = COMPILER_FLAG_STRENGTH_REDUCE },
+    { .name = "-fbranch-opt", .flags = COMPILER_FLAG_BRANCH_OPT },
+    { .name = "-ftail-calls", .flags = COMPILER_FLAG_TAIL_CALL },
+    { .name = "-fdead-strip", .flags = COMPILER_FLAG_DEAD_STRIP },
+    { .name = "-fmerge-constants", .flags = COMPILER_FLAG_MERGE_CONSTANTS },
+    { .name = "--verify-encoding", .flags = COMPILER_FLAG_VERIFY_ENCODING },
+    { .name = "--compress", .flags = COMPILER_FLAG_COMPRESS },
+};
+
+static option_entry_t *option_from_string(const char *name)
+{
+    /* iterating through table */
+    for(size_t i = 0; i < sizeof(option_table) / sizeof(option_table[0]); i++)
+    {
+        /* check if option name matches */
+        if(strcmp(option_table[i].name, name) == 0)
+        {
+            return &option_table[i];
+        }
+    }
+
+    return NULL;
+}
+
+static void usage(const char *name)
+{
+    fprintf(stderr, "Usage: %s [options] -c <l64 assembly files, - for stdin>\n", name);
+    fprintf(stderr, "       %s [options] --batch=<file>\n", name);
+    fprintf(stderr, "       %s --lsp\n", name);
+    fprintf(stderr, "Options:\n");
+    fprintf(stderr, "  -o <file>            write the boot image to file instead of a.out\n");
+    fprintf(stderr, "  -MD                  write a make dependency file next to the output\n");
+    fprintf(stderr, "  -MF <file>           write the make dependency file to file\n");
+    fprintf(stderr, "  --map=<file>         write the address and kind of every label to file\n");
+    fprintf(stderr, "  --debug-info=<file>  write a mappable symbol and address to line table to file\n");
+    fprintf(stderr, "  -O                   enable all optimizations\n");
+    fprintf(stderr, "  -fstrength-reduce    rewrite mul/div/mod by powers of two to shl/shr/and\n");
+    fprintf(stderr, "  -fbranch-opt         thread jump chains and remove branches to the next instruction\n");
+    fprintf(stderr, "  -ftail-calls         turn bl directly followed by ret into jmp\n");
+    fprintf(stderr, "  -fdead-strip         drop code and data not reachable from _start or a %%export%%\n");
+    fprintf(stderr, "  -fmerge-constants    share identical entries and string tails in .rodata\n");
+    fprintf(stderr, "  --profile=<file>     order functions by the \"function count\" and \"caller callee count\" lines in file\n");
+    fprintf(stderr, "  --instrument=<file>  count every basic block in .bss, write what each counter belongs to to file\n");
+    fprintf(stderr, "  --layout=<file>      place sections by the \"name [base=address] [align=bytes]\" lines in file\n");
+    fprintf(stderr, "  -falign-functions=N  align every global label in code to N bytes\n");
+    fprintf(stderr, "  -Rpass               report every rewrite done by an optimization\n");
+    fprintf(stderr, "  --verify-encoding    check every template encoded instruction against the bitwalker encoding\n");
+    fprintf(stderr, "  --compress           write a block compressed image, la64unlz or the la64lz library inflate it\n");
+    fprintf(stderr, "  --watch              keep running and rebuild whenever an input changes, rereading only what changed\n");
+    fprintf(stderr, "  --lsp                serve definitions, references and diagnostics to an editor over stdio\n");
+    fprintf(stderr, "  --batch=<file>       build every \"output: inputs...\" line in file as a program of its own\n");
+    fprintf(stderr, "  --jobs=N             build N programs of a batch at once instead of one per cpu\n");
+}
 
 int main(int argc, char *argv[])
 {
+    compiler_options_t opt = { .flags = COMPILER_FLAG_NONE, .output = "a.out" };
+    char *depfile = NULL;
+    int md = 0;
+    const char *batch = NULL;
+    unsigned long jobs = 0;
+    int single = 0;
+    int watch = 0;
+
     /* checking for sufficient arguments */
-    if(argc < 2 || strcmp(argv[1], "-c") != 0)
+    if(argc < 2)
+    {
+        usage(argv[0]);
+        return 1;
+    }
+
+    /* the language server speaks the protocol on stdio and takes its files from the editor */
+    if(argc == 2 && strcmp(argv[1], "--lsp") == 0)
+    {
+        return lsp_serve();
+    }
+
+    /* allocating memory for file list */
+    char **files = calloc(sizeof(char*), argc);
+    int file_cnt = 0;
+    int compile = 0;
+
+    /* parsing options and copying file paths */
+    for(int i = 1; i < argc; i++)
+    {
+        if(strcmp(argv[i], "-c") == 0)
+        {
+            compile = 1;
+            continue;
+        }
+
+        if((strcmp(argv[i], "-o") == 0 || strcmp(argv[i], "-MF") == 0) && i + 1 < argc)
+        {
+            if(argv[i][1] == 'o')
+            {
+                opt.output = argv[i + 1];
+            }
+            else
+            {
+                opt.depfile = argv[i + 1];
+            }
+
+            single = 1;
+            i++;
+            continue;
+        }
+
+        if(strncmp(argv[i], "--map=", 6) == 0)
+        {
+            opt.map = argv[i] + 6;
+            single = 1;
+            continue;
+        }
+
+        if(strncmp(argv[i], "--debug-info=", 13) == 0)
+        {
+            opt.debuginfo = argv[i] + 13;
+            single = 1;
+            continue;
+        }
+
+        if(strncmp(argv[i], "--profile=", 10) == 0)
+        {
+            opt.profile = argv[i] + 10;
+            continue;
+        }
+
+        if(strncmp(argv[i], "--instrument=", 13) == 0)
+        {
+            opt.instrument = argv[i] + 13;
+            single = 1;
+            continue;
+        }
+
+        if(strncmp(argv[i], "--layout=", 9) == 0)
+        {
+            opt.layout = argv[i] + 9;
+            continue;
+        }
+
+        if(strncmp(argv[i], "--batch=", 8) == 0)
+        {
+            batch = argv[i] + 8;
+            continue;
+        }
+
+        if(strncmp(argv[i], "--jobs=", 7) == 0)
+        {
+            char *end = NULL;
+            jobs = strtoul(argv[i] + 7, &end, 0);
+
+            if(!isdigit((unsigned char)argv[i][7]) || *end != '\0' || jobs == 0)
+            {
+                fprintf(stderr, "%s: expected a count of jobs in \"%s\"\n", argv[0], argv[i]);
+                return 1;
+            }
+
+            continue;
+        }
+
+        if(strncmp(argv[i], "-falign-functions=", 18) == 0)
+        {
+            /* strtoull would take a sign, blanks or trailing garbage, so the whole argument has to be the number */
+            char *end = NULL;
+            opt.align_functions = strtoull(argv[i] + 18, &end, 0);
+
+            if(!isdigit((unsigned char)argv[i][18]) || *end != '\0' ||
+               (opt.align_functions & (opt.align_functions - 1)) != 0)
+            {
+                fprintf(stderr, "%s: expected a power of two in \"%s\"\n", argv[0], argv[i]);
+                return 1;
+            }
+
+            continue;
+        }
+
+        if(strcmp(argv[i], "--watch") == 0)
+        {
+            watch = 1;
+            continue;
+        }
+
+        if(strcmp(argv[i], "-MD") == 0)
+        {
+            md = 1;
+            continue;
+        }
+
+        /* everything starting with '-' is a option, except '-' alone which is standard input */
+        if(argv[i][0] == '-' && argv[i][1] != '\0')
+        {
+            option_entry_t *oe = option_from_string(argv[i]);
+
+            if(oe == NULL)
+            {
+                fprintf(stderr, "%s: unknown option \"%s\"\n", argv[0], argv[i]);
+                usage(argv[0]);
+                return 1;
+            }
+
+            opt.flags |= oe->flags;
+            continue;
+        }
+
+        files[file_cnt++] = strdup(argv[i]);
+    }
+
+    /* a batch names its own inputs and outputs, everything else applies to every job */
+    if(batch != NULL)
     {
-        fprintf(stderr, "Usage: %s -c <l64 assembly files>\n", argv[0]);
+        if(compile || file_cnt > 0 || single || watch)
+        {
+            fprintf(stderr, "%s: -c, -o, -MF, --map, --debug-info, --instrument and --watch are per program and do not go with --batch\n", argv[0]);
+            return 1;
+        }
+
+        free(files);
+        return compile_batch(batch, jobs, md, &opt);
+    }
+
+    if(!compile || file_cnt == 0)
+    {
+        usage(argv[0]);
         return 1;
     }
-    
-    /* allocating memory for file list and copying file paths into it */
-    char **files = calloc(sizeof(char*), argc - 2);
-    for(int i = 0; i < (argc - 2); i++)
+
+    /* the dependency file defaults to the output with a .d suffix */
+    if(md && opt.depfile == NULL)
     {
-        files[i] = strdup(argv[i + 2]);
+        asprintf(&depfile, "%s.d", opt.output);
+        opt.depfile = depfile;
     }
 
-    /* compiling using those files */
-    compile_files((const char**)files, argc - 2);
+    /* compiling using those files, over and over again when watching */
+    if(watch)
+    {
+        compile_watch((const char**)files, file_cnt, &opt);
+    }
+    else
+    {
+        compile_files((const char**)files, file_cnt, &opt);
+    }
 
     /* releasing those files */
-    for(int i = 0; i < (argc - 2); i++)
+    for(int i = 0; i < file_cnt; i++)
     {
         free(files[i]);
     }
     free(files);
+    free(depfile);
 
     return 0;
 }
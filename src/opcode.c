@@ -23,6 +23,7 @@
  */
 
 #include <la64asm/opcode.h>
+#include <la64asm/intern.h>
 #include <stdlib.h>
 #include <string.h>
 
@@ -88,11 +89,30 @@ opcode_entry_t *opcode_from_string(const char *name)
         return NULL;
     }
 
+    /* interning the mnemonics once per thread, after that they compare by pointer */
+    static _Thread_local const char *interned[LA64_OPCODE_MAX + 1];
+
+    if(interned[0] == NULL)
+    {
+        for(unsigned char opcode = 0x00; opcode < LA64_OPCODE_MAX + 1; opcode++)
+        {
+            interned[opcode] = intern(opcode_table[opcode].name);
+        }
+    }
+
+    /* anything never interned is no mnemonic */
+    name = intern_find(name);
+
+    if(name == NULL)
+    {
+        return NULL;
+    }
+
     /* iterating through table */
     for(unsigned char opcode = 0x00; opcode < LA64_OPCODE_MAX + 1; opcode++)
     {
         /* check if opcode name matches */
-        if(strcmp(opcode_table[opcode].name, name) == 0)
+        if(interned[opcode] == name)
         {
             return &opcode_table[opcode];
         }
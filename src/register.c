@@ -23,6 +23,7 @@
  */
 
 #import <la64asm/register.h>
+#include <la64asm/intern.h>
 #include <stdlib.h>
 #include <string.h>
 
@@ -70,11 +71,30 @@ register_entry_t *register_from_string(const char *name)
         return NULL;
     }
 
+    /* interning the register names once per thread, after that they compare by pointer */
+    static _Thread_local const char *interned[LA64_REGISTER_MAX + 1];
+
+    if(interned[0] == NULL)
+    {
+        for(unsigned char reg = 0x00; reg < (LA64_REGISTER_MAX + 1); reg++)
+        {
+            interned[reg] = intern(register_table[reg].name);
+        }
+    }
+
+    /* anything never interned is no register */
+    name = intern_find(name);
+
+    if(name == NULL)
+    {
+        return NULL;
+    }
+
     /* iterating through table */
     for(unsigned char reg = 0x00; reg < (LA64_REGISTER_MAX + 1); reg++)
     {
         /* check if opcode name matches */
-        if(strcmp(register_table[reg].name, name) == 0)
+        if(interned[reg] == name)
         {
             return &register_table[reg];
         }
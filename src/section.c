@@ -26,124 +26,773 @@
 #include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
 #include <la64asm/section.h>
 #include <lautils/parser.h>
 #include <lautils/bitwalker.h>
 #include <la64asm/code.h>
 #include <la64asm/diag.h>
+#include <la64asm/expr.h>
+#include <la64asm/number.h>
+#include <la64asm/compiler.h>
+#include <la64asm/label.h>
+#include <la64asm/intern.h>
 
-void code_token_section(compiler_invocation_t *ci)
+static bool code_token_incbin(compiler_invocation_t *ci,
+                              compiler_line_t *cl)
+{
+    /* the directive is either on its own or follows the name of the entry */
+    uint64_t arg = 1;
+    if(strcmp(cl->token[0].str, ".incbin") != 0)
+    {
+        if(cl->token_cnt < 2 || strcmp(cl->token[1].str, ".incbin") != 0)
+        {
+            return false;
+        }
+
+        label_add(ci, cl->token[0].str, ci->image_addr, &(cl->token[0]));
+        arg = 2;
+    }
+
+    if(cl->token_cnt < arg + 1 || cl->token_cnt > arg + 3)
+    {
+        diag_error(&(cl->token[arg - 1]), "\".incbin\" takes a quoted path, a optional offset and a optional length\n");
+    }
+
+    compiler_token_t *ct = &(cl->token[arg]);
+    size_t len = strlen(ct->str);
+
+    if(len < 2 || ct->str[0] != '"' || ct->str[len - 1] != '"')
+    {
+        diag_error(ct, "\".incbin\" expects a quoted path\n");
+    }
+
+    /* offset and length are evaluated first, nothing is open yet if they fail */
+    uint64_t off = (cl->token_cnt > arg + 1) ? expr_eval_constant(ci, &(cl->token[arg + 1])) : 0;
+    bool whole = (cl->token_cnt <= arg + 2);
+    uint64_t cnt = whole ? 0 : expr_eval_constant(ci, &(cl->token[arg + 2]));
+
+    /* blobs are looked up like includes, next to the file referencing them first, the path goes with the invocation if anything fails */
+    char *path = code_include_path(ci->file[cl->file_idx].path, ct->str + 1, len - 2);
+    code_resource_hold(ci, path, free);
+
+    int fd = open(path, O_RDONLY);
+    struct stat fdstat;
+
+    if(fd >= 0 && fstat(fd, &fdstat) < 0)
+    {
+        close(fd);
+        fd = -1;
+    }
+
+    if(fd < 0)
+    {
+        diag_error(ct, "unable to open \"%s\"\n", path);
+    }
+
+    code_dep_add(ci, path);
+
+    /* the length defaults to the rest of the file, every error below closes it first */
+    uint64_t size = fdstat.st_size;
+    cnt = (whole && off <= size) ? size - off : cnt;
+
+    if(off > size)
+    {
+        close(fd);
+        diag_error(&(cl->token[arg + 1]), "offset %lu is past the end of \"%s\"\n", off, path);
+    }
+
+    if(cnt > size - off)
+    {
+        close(fd);
+        diag_error(&(cl->token[arg + 2]), "length %lu is past the end of \"%s\"\n", cnt, path);
+    }
+
+    if(ci->image_addr + cnt > sizeof(ci->image))
+    {
+        close(fd);
+        diag_error(ct, "\"%s\" does not fit into the image\n", path);
+    }
+
+    /* mapping the blob so it lands in the image with a single copy, the mapping has to start on a page */
+    if(cnt > 0)
+    {
+        uint64_t page = off & ~((uint64_t)sysconf(_SC_PAGESIZE) - 1);
+        unsigned char *blob = mmap(NULL, cnt + (off - page), PROT_READ, MAP_PRIVATE, fd, page);
+
+        if(blob == MAP_FAILED)
+        {
+            close(fd);
+            diag_error(ct, "unable to map \"%s\"\n", path);
+        }
+
+        memcpy(&(ci->image[ci->image_addr]), blob + (off - page), cnt);
+        munmap(blob, cnt + (off - page));
+        ci->image_addr += cnt;
+    }
+
+    close(fd);
+    code_resource_drop(ci, path);
+    return true;
+}
+
+static void code_token_data(compiler_invocation_t *ci,
+                            compiler_line_t *cl)
 {
-    /* iterating for section token type */
-    for(unsigned long i = 0; i < ci->line_cnt; i++)
+    /* data is padded with zeros */
+    if(code_token_align(cl, 0))
     {
-        if(ci->line[i].type == COMPILER_LINE_TYPE_SECTION)
+        return;
+    }
+
+    /* blobs skip the token parser entirely */
+    if(code_token_incbin(ci, cl))
+    {
+        return;
+    }
+
+    /* checking count */
+    if(cl->token_cnt < 3)
+    {
+        diag_error(&(cl->token[cl->token_cnt - 1]), "sufficient tokens for entry in .data section\n");
+    }
+
+    /* inserting address as label */
+    label_add(ci, cl->token[0].str, ci->image_addr, &(cl->token[0]));
+
+    /* checking if its known */
+    int dbs = 8;
+    if(strcmp(cl->token[1].str, "dw") == 0)
+    {
+        dbs = 16;
+    }
+    else if(strcmp(cl->token[1].str, "dd") == 0)
+    {
+        dbs = 32;
+    }
+    else if(strcmp(cl->token[1].str, "dq") == 0)
+    {
+        dbs = 64;
+    }
+    else if(strcmp(cl->token[1].str, "db") != 0)
+    {
+        diag_error(&(cl->token[1]), "\"%s\" is not a valid data type for .data sections\n", cl->token[1].str);
+    }
+
+    /* iterating through the chain */
+    for(unsigned long a = 2; a < cl->token_cnt; a++)
+    {
+        /* plain numbers are stored straight into the image, little endian */
+        uint64_t value = 0;
+        if(number_parse(cl->token[a].str, &value))
+        {
+            for(int b = 0; b < dbs / 8; b++)
+            {
+                ci->image[ci->image_addr++] = (unsigned char)(value >> (b * 8));
+            }
+            continue;
+        }
+
+        /* folding expressions at assemble time */
+        if(expr_is_expression(cl->token[a].str))
         {
-            if(strcmp(ci->line[i].token[1].str, ".data") == 0)
+            expr_value_t ev = { 0 };
+            expr_eval(ci, &(cl->token[a]), NULL, &ev);
+
+            if(ev.sym != NULL)
             {
-                /* iterating till section data is over */
-                i++;
-                for(; i < ci->line_cnt && ci->line[i].type == COMPILER_LINE_TYPE_SECTION_DATA; i++)
+                /* a difference of labels is a size or offset and may be narrow, a address is not */
+                if(dbs != 64 && ev.sub == NULL)
                 {
-                    /* checking count */
-                    if(ci->line[i].token_cnt < 3)
-                    {
-                        diag_error(&(ci->line[i].token[ci->line[i].token_cnt - 1]), "sufficient tokens for entry in .data section\n");
-                    }
-
-                    /* inserting address as label */
-                    ci->label[ci->label_cnt].name = strdup(ci->line[i].token[0].str);
-                    ci->label[ci->label_cnt++].addr = ci->image_addr;
-
-                    /* checking if its known */
-                    int dbs = 8;
-                    if(strcmp(ci->line[i].token[1].str, "dw") == 0)
-                    {
-                        dbs = 16;
-                    }
-                    else if(strcmp(ci->line[i].token[1].str, "dd") == 0)
-                    {
-                        dbs = 32;
-                    }
-                    else if(strcmp(ci->line[i].token[1].str, "dq") == 0)
-                    {
-                        dbs = 64;
-                    }
-                    else if(strcmp(ci->line[i].token[1].str, "db") != 0)
-                    {
-                        printf("[!] %s is not a valid data type for .data sections\n", ci->line[i].token[1].str);
-                        exit(1);
-                    }
-
-                    /* iterating through the chain */
-                    for(unsigned long a = 2; a < ci->line[i].token_cnt; a++)
-                    {
-                        /* using low level type parser */
-                        parser_return_t pr = parse_value_from_string(ci->line[i].token[a].str);
-
-                        /* checking type */
-                        if(pr.type == laParserValueTypeBuffer)
-                        {
-                            /* its a buffer so we copy the buffer into section */
-                            char *buffer = (char*)pr.value;
-                            for(unsigned short j = 0; j < pr.len; j++)
-                            {
-                                ci->image[ci->image_addr + j] = (unsigned char)buffer[j];
-                            }
-                            ci->image_addr += pr.len;
-                        }
-                        else if(pr.type == laParserValueTypeString)
-                        {
-                            if(dbs != 64)
-                            {
-                                diag_error(&(ci->line[i].token[a]), "don't put labels inside improper data types, i watch you!\n");
-                            }
-
-                            /* using finally the relocation table to its full extend */
-                            ci->rtlb[ci->rtlb_cnt].name = strdup(ci->line[i].token[a].str);
-                            ci->rtlb[ci->rtlb_cnt].ctlink = &(ci->line[i].token[a]);
-                            bitwalker_init(&(ci->rtlb[ci->rtlb_cnt++].bw), &(ci->image[ci->image_addr]), 8, BW_LITTLE_ENDIAN);
-                            ci->image_addr += 8;
-                        }
-                        else
-                        {
-                            bitwalker_t bw;
-
-                            /* storing value */
-                            bitwalker_init(&bw, &(ci->image[ci->image_addr]), dbs / 8, BW_LITTLE_ENDIAN);
-                            bitwalker_write(&bw, pr.value, dbs);
-                            ci->image_addr += bitwalker_bytes_used(&bw);
-                        }
-                    }
+                    free(ev.sym);
+                    free(ev.sub);
+                    diag_error(&(cl->token[a]), "don't put labels inside improper data types, i watch you!\n");
                 }
-                i--;
+
+                /* label relative, the relocation carries the rest */
+                reloc_table_entry *rt = code_reloc_add(ci);
+                rt->name = intern(ev.sym);
+                rt->sub = (ev.sub == NULL) ? NULL : intern(ev.sub);
+                free(ev.sym);
+                free(ev.sub);
+                rt->addend = ev.value;
+                rt->bits = (dbs == 64) ? 0 : dbs;
+                rt->ctlink = &(cl->token[a]);
+                bitwalker_init(&(rt->bw), &(ci->image[ci->image_addr]), dbs / 8, BW_LITTLE_ENDIAN);
+                ci->image_addr += dbs / 8;
             }
-            else if(strcmp(ci->line[i].token[1].str, ".bss") == 0)
+            else
             {
-                /* finding variable type */
-                i++;
-                for(; i < ci->line_cnt && ci->line[i].type == COMPILER_LINE_TYPE_SECTION_DATA; i++)
-                {
-                    /* checking count */
-                    if(ci->line[i].token_cnt < 2)
-                    {
-                        printf("[!] not enough tokens for section data in .bss\n");
-                        exit(1);
-                    }
+                bitwalker_t bw;
+
+                /* storing value */
+                bitwalker_init(&bw, &(ci->image[ci->image_addr]), dbs / 8, BW_LITTLE_ENDIAN);
+                bitwalker_write(&bw, ev.value, dbs);
+                ci->image_addr += bitwalker_bytes_used(&bw);
+            }
+
+            continue;
+        }
+
+        /* using low level type parser */
+        parser_return_t pr = parse_value_from_string(cl->token[a].str);
+
+        /* checking type */
+        if(pr.type == laParserValueTypeBuffer)
+        {
+            /* its a buffer so we copy the buffer into section */
+            char *buffer = (char*)pr.value;
+            for(unsigned short j = 0; j < pr.len; j++)
+            {
+                ci->image[ci->image_addr + j] = (unsigned char)buffer[j];
+            }
+            ci->image_addr += pr.len;
+        }
+        else if(pr.type == laParserValueTypeString)
+        {
+            if(dbs != 64)
+            {
+                diag_error(&(cl->token[a]), "don't put labels inside improper data types, i watch you!\n");
+            }
+
+            /* using finally the relocation table to its full extend */
+            reloc_table_entry *rt = code_reloc_add(ci);
+            rt->name = intern(cl->token[a].str);
+            rt->ctlink = &(cl->token[a]);
+            bitwalker_init(&(rt->bw), &(ci->image[ci->image_addr]), 8, BW_LITTLE_ENDIAN);
+            ci->image_addr += 8;
+        }
+        else
+        {
+            bitwalker_t bw;
+
+            /* storing value */
+            bitwalker_init(&bw, &(ci->image[ci->image_addr]), dbs / 8, BW_LITTLE_ENDIAN);
+            bitwalker_write(&bw, pr.value, dbs);
+            ci->image_addr += bitwalker_bytes_used(&bw);
+        }
+    }
+}
+
+typedef struct {
+    uint64_t label;                         /* index of the label naming the entry */
+    unsigned char *data;                    /* payload of the entry */
+    uint64_t len;                           /* length of the payload */
+    uint64_t align;                         /* alignment the entry asked for */
+    compiler_token_t *ct;                   /* originator of the entry */
+} section_const_t;
+
+typedef struct {
+    section_const_t *entry;                 /* mergeable entries of .rodata */
+    uint64_t entry_cnt;                     /* count of entries */
+    uint64_t align;                         /* alignment pending for the next entry */
+} section_pool_t;
+
+static void code_token_rodata(compiler_invocation_t *ci,
+                              compiler_line_t *cl,
+                              section_pool_t *pool)
+{
+    /* alignment sticks to the entry following it, so it survives the entry moving */
+    uint64_t align = 0;
+    if(code_token_align_value(cl, &align))
+    {
+        pool->align = (align > pool->align) ? align : pool->align;
+        return;
+    }
+
+    uint64_t mark = ci->image_addr;
+    uint64_t rtlb_cnt = ci->rtlb_cnt;
+    uint64_t label_cnt = ci->label_cnt;
+
+    if(pool->align > 1)
+    {
+        code_image_align(ci, &(cl->token[0]), pool->align, 0);
+    }
+
+    uint64_t start = ci->image_addr;
+    code_token_data(ci, cl);
+
+    /* payloads needing relocations or without a name stay where they are */
+    if(ci->rtlb_cnt != rtlb_cnt || ci->label_cnt == label_cnt)
+    {
+        pool->align = 0;
+        return;
+    }
+
+    /* taking the payload back out of the image, it is placed once everything is known */
+    pool->entry = realloc(pool->entry, (pool->entry_cnt + 1) * sizeof(section_const_t));
+    section_const_t *sc = &(pool->entry[pool->entry_cnt++]);
+    sc->label = label_cnt;
+    sc->len = ci->image_addr - start;
+    sc->data = malloc(sc->len + 1);
+    sc->align = (pool->align > 1) ? pool->align : 1;
+    sc->ct = &(cl->token[0]);
+    memcpy(sc->data, &(ci->image[start]), sc->len);
+
+    memset(&(ci->image[mark]), 0, ci->image_addr - mark);
+    ci->image_addr = mark;
+    pool->align = 0;
+}
+
+static int section_const_compare(const void *a,
+                                 const void *b)
+{
+    const section_const_t *sa = a;
+    const section_const_t *sb = b;
+
+    /* ordering by the reversed payload puts every suffix right behind the payload ending in it */
+    for(uint64_t i = 1; i <= sa->len && i <= sb->len; i++)
+    {
+        if(sa->data[sa->len - i] != sb->data[sb->len - i])
+        {
+            return (sa->data[sa->len - i] < sb->data[sb->len - i]) ? 1 : -1;
+        }
+    }
+
+    /* longer and stricter aligned payloads own the copy */
+    if(sa->len != sb->len)
+    {
+        return (sa->len < sb->len) ? 1 : -1;
+    }
+
+    if(sa->align != sb->align)
+    {
+        return (sa->align < sb->align) ? 1 : -1;
+    }
+
+    return (sa->label < sb->label) ? -1 : (sa->label > sb->label);
+}
+
+static void section_pool_place(compiler_invocation_t *ci,
+                               section_pool_t *pool)
+{
+    qsort(pool->entry, pool->entry_cnt, sizeof(section_const_t), section_const_compare);
+
+    section_const_t *owner = NULL;
+    uint64_t owner_end = 0;
+
+    for(uint64_t i = 0; i < pool->entry_cnt; i++)
+    {
+        section_const_t *sc = &(pool->entry[i]);
+
+        /* identical payloads are shared, strings also share the tail of a longer one */
+        if(owner != NULL &&
+           sc->len <= owner->len &&
+           (sc->len == owner->len || (sc->len > 0 && sc->data[sc->len - 1] == '\0')) &&
+           memcmp(&(owner->data[owner->len - sc->len]), sc->data, sc->len) == 0 &&
+           ((owner_end - sc->len) & (sc->align - 1)) == 0)
+        {
+            ci->label[sc->label].addr = owner_end - sc->len;
+
+            if(ci->opt->flags & COMPILER_FLAG_REPORT)
+            {
+                diag_note(sc->ct, "merged constant \"%s\" into \"%s\"\n", ci->label[sc->label].name, ci->label[owner->label].name);
+            }
+
+            continue;
+        }
+
+        if(ci->image_addr + sc->len > sizeof(ci->image))
+        {
+            diag_error(sc->ct, "\"%s\" does not fit into the image\n", ci->label[sc->label].name);
+        }
+
+        code_image_align(ci, sc->ct, sc->align, 0);
+        ci->label[sc->label].addr = ci->image_addr;
+        memcpy(&(ci->image[ci->image_addr]), sc->data, sc->len);
+        ci->image_addr += sc->len;
+
+        owner = sc;
+        owner_end = ci->image_addr;
+    }
+}
+
+static void section_pool_free(void *ptr)
+{
+    section_pool_t *pool = ptr;
+
+    for(uint64_t i = 0; i < pool->entry_cnt; i++)
+    {
+        free(pool->entry[i].data);
+    }
+
+    free(pool->entry);
+    free(pool);
+}
+
+static bool section_name_is(const char *name,
+                            const char *family)
+{
+    /* ".text" covers ".text" itself and every ".text.<something>" */
+    size_t len = strlen(family);
+    return strncmp(name, family, len) == 0 && (name[len] == '\0' || name[len] == '.');
+}
+
+uint8_t code_section_kind(const char *name)
+{
+    if(section_name_is(name, ".text"))
+    {
+        return COMPILER_SECTION_KIND_CODE;
+    }
+    else if(section_name_is(name, ".bss"))
+    {
+        return COMPILER_SECTION_KIND_BSS;
+    }
 
-                    /* insert label into label array */
-                    ci->label[ci->label_cnt].name = strdup(ci->line[i].token[0].str);
-                    ci->label[ci->label_cnt++].addr = ci->image_addr;
+    return COMPILER_SECTION_KIND_DATA;
+}
 
-                    /* offset image address by value */
-                    parser_return_t pr = parse_value_from_string(ci->line[i].token[1].str);
+static uint64_t section_lookup(compiler_invocation_t *ci,
+                               const char *name)
+{
+    for(uint64_t i = 0; i < ci->section_cnt; i++)
+    {
+        if(strcmp(ci->section[i].name, name) == 0)
+        {
+            return i;
+        }
+    }
 
-                    /* checking if the type makes sense */
+    return COMPILER_SECTION_NONE;
+}
 
-                    ci->image_addr += pr.value;
+static uint64_t section_add(compiler_invocation_t *ci,
+                            const char *name)
+{
+    uint64_t idx = section_lookup(ci, name);
+
+    if(idx != COMPILER_SECTION_NONE)
+    {
+        return idx;
+    }
+
+    ci->section = realloc(ci->section, (ci->section_cnt + 1) * sizeof(compiler_section_t));
+    ci->section[ci->section_cnt].name = strdup(name);
+    ci->section[ci->section_cnt].kind = code_section_kind(name);
+    ci->section[ci->section_cnt].base = 0;
+    ci->section[ci->section_cnt].align = 0;
+    ci->section[ci->section_cnt].order = UINT64_MAX;
+
+    return ci->section_cnt++;
+}
+
+void code_token_section_assign(compiler_invocation_t *ci)
+{
+    /* data belongs to the last section named, code to the last code section named or .text */
+    uint64_t code = COMPILER_SECTION_NONE;
+    uint64_t data = COMPILER_SECTION_NONE;
+
+    for(uint64_t i = 0; i < ci->line_cnt; i++)
+    {
+        compiler_line_t *cl = &(ci->line[i]);
+
+        switch(cl->type)
+        {
+            case COMPILER_LINE_TYPE_SECTION:
+                if(cl->token_cnt < 2)
+                {
+                    diag_error(&(cl->token[0]), "section without a name\n");
+                }
+
+                cl->section = section_add(ci, cl->token[1].str);
+
+                if(ci->section[cl->section].kind == COMPILER_SECTION_KIND_CODE)
+                {
+                    code = cl->section;
+                }
+                else
+                {
+                    data = cl->section;
                 }
-                i--;
+                break;
+            case COMPILER_LINE_TYPE_SECTION_DATA:
+                cl->section = data;
+                break;
+            case COMPILER_LINE_TYPE_ASM:
+            case COMPILER_LINE_TYPE_GLOBAL_LABEL:
+            case COMPILER_LINE_TYPE_LOCAL_LABEL:
+                if(code == COMPILER_SECTION_NONE)
+                {
+                    code = section_add(ci, ".text");
+                }
+                cl->section = code;
+                break;
+            default:
+                cl->section = code;
+                break;
+        }
+    }
+}
+
+static void section_layout_load(compiler_invocation_t *ci)
+{
+    const char *path = ci->opt->layout;
+
+    if(path == NULL)
+    {
+        return;
+    }
+
+    FILE *fp = fopen(path, "r");
+
+    if(fp == NULL)
+    {
+        diag_perror(path);
+        diag_exit(EXIT_FAILURE);
+    }
+
+    /* "name [base=address] [align=bytes]" per line, in the order the sections go into the image */
+    char *line = NULL;
+    size_t cap = 0;
+    uint64_t num = 0;
+    uint64_t order = 0;
+
+    while(getline(&line, &cap, fp) > 0)
+    {
+        num++;
+        line[strcspn(line, "#\r\n")] = '\0';
+
+        char *save = NULL;
+        char *name = strtok_r(line, " \t", &save);
+
+        if(name == NULL)
+        {
+            continue;
+        }
+
+        /* sections the source never uses are fine, the layout may be shared */
+        uint64_t idx = section_lookup(ci, name);
+        compiler_section_t dummy = { 0 };
+        compiler_section_t *sect = (idx == COMPILER_SECTION_NONE) ? &dummy : &(ci->section[idx]);
+        sect->order = order++;
+
+        for(char *tok = strtok_r(NULL, " \t", &save); tok != NULL; tok = strtok_r(NULL, " \t", &save))
+        {
+            char *end = NULL;
+
+            if(strncmp(tok, "base=", 5) == 0)
+            {
+                sect->base = strtoull(tok + 5, &end, 0);
+            }
+            else if(strncmp(tok, "align=", 6) == 0)
+            {
+                sect->align = strtoull(tok + 6, &end, 0);
             }
+
+            if(end == NULL || *end != '\0')
+            {
+                fprintf(diag_file(stderr), "%s:%lu: expected base=<address> or align=<bytes>, got \"%s\"\n", path, num, tok);
+                free(line);
+                fclose(fp);
+                diag_exit(EXIT_FAILURE);
+            }
+        }
+
+        if(sect->align != 0 && (sect->align & (sect->align - 1)) != 0)
+        {
+            fprintf(diag_file(stderr), "%s:%lu: alignment %lu is not a power of two\n", path, num, sect->align);
+            free(line);
+            fclose(fp);
+            diag_exit(EXIT_FAILURE);
         }
+
+        if(sect->base != 0 && code_section_kind(name) == COMPILER_SECTION_KIND_BSS)
+        {
+            fprintf(diag_file(stderr), "%s:%lu: \"%s\" is not part of the image and cannot have a base\n", path, num, name);
+            free(line);
+            fclose(fp);
+            diag_exit(EXIT_FAILURE);
+        }
+    }
+
+    free(line);
+    fclose(fp);
+}
+
+static _Thread_local compiler_invocation_t *section_sort_ctx;
+
+static int section_order_compare(const void *a,
+                                 const void *b)
+{
+    uint64_t ia = *(const uint64_t*)a;
+    uint64_t ib = *(const uint64_t*)b;
+    compiler_section_t *sa = &(section_sort_ctx->section[ia]);
+    compiler_section_t *sb = &(section_sort_ctx->section[ib]);
+
+    /* listed sections first, the rest like it always was, data, then code, then .bss */
+    if(sa->order != sb->order)
+    {
+        return (sa->order < sb->order) ? -1 : 1;
     }
-}
\ No newline at end of file
+
+    static const int rank[] = { [COMPILER_SECTION_KIND_DATA] = 0, [COMPILER_SECTION_KIND_CODE] = 1, [COMPILER_SECTION_KIND_BSS] = 2 };
+
+    if(rank[sa->kind] != rank[sb->kind])
+    {
+        return (rank[sa->kind] < rank[sb->kind]) ? -1 : 1;
+    }
+
+    return (ia < ib) ? -1 : (ia > ib);
+}
+
+static void section_emit_data(compiler_invocation_t *ci,
+                              uint64_t section)
+{
+    /* read only data is laid out like any other data unless it may be merged */
+    bool merge = section_name_is(ci->section[section].name, ".rodata") &&
+                 (ci->opt->flags & COMPILER_FLAG_MERGE_CONSTANTS);
+    section_pool_t *pool = calloc(1, sizeof(section_pool_t));
+    code_resource_hold(ci, pool, section_pool_free);
+
+    for(uint64_t i = 0; i < ci->line_cnt; i++)
+    {
+        compiler_line_t *cl = &(ci->line[i]);
+
+        if(cl->type != COMPILER_LINE_TYPE_SECTION_DATA || cl->section != section)
+        {
+            continue;
+        }
+
+        if(merge)
+        {
+            code_token_rodata(ci, cl, pool);
+        }
+        else
+        {
+            code_token_data(ci, cl);
+        }
+    }
+
+    /* merged constants go behind the rest of their section */
+    section_pool_place(ci, pool);
+    code_resource_drop(ci, pool);
+}
+
+static void section_emit_bss(compiler_invocation_t *ci,
+                             uint64_t section)
+{
+    for(uint64_t i = 0; i < ci->line_cnt; i++)
+    {
+        compiler_line_t *cl = &(ci->line[i]);
+
+        if(cl->type != COMPILER_LINE_TYPE_SECTION_DATA || cl->section != section)
+        {
+            continue;
+        }
+
+        /* reserved space is aligned relative to the start of .bss */
+        uint64_t align = 0;
+        if(code_token_align_value(cl, &align))
+        {
+            ci->bss_size = (ci->bss_size + align - 1) & ~(align - 1);
+            ci->bss_align = (align > ci->bss_align) ? align : ci->bss_align;
+            continue;
+        }
+
+        /* checking count */
+        if(cl->token_cnt < 2)
+        {
+            diag_error(&(cl->token[0]), "not enough tokens for section data in .bss\n");
+        }
+
+        /* insert label into label array, it gets its address once the image size is known */
+        ci->bss_label = realloc(ci->bss_label, (ci->bss_label_cnt + 1) * sizeof(uint64_t));
+        ci->bss_label[ci->bss_label_cnt++] = label_add(ci, cl->token[0].str, ci->bss_size, &(cl->token[0]));
+
+        /* only the size is recorded, nothing of .bss ends up in the image */
+        ci->bss_size += expr_eval_constant(ci, &(cl->token[1]));
+    }
+}
+
+void code_token_section(compiler_invocation_t *ci)
+{
+    section_layout_load(ci);
+
+    /* ordering the sections */
+    uint64_t *order = calloc(ci->section_cnt, sizeof(uint64_t));
+    code_resource_hold(ci, order, free);
+    for(uint64_t i = 0; i < ci->section_cnt; i++)
+    {
+        order[i] = i;
+    }
+
+    section_sort_ctx = ci;
+    qsort(order, ci->section_cnt, sizeof(uint64_t), section_order_compare);
+
+    /* emitting them one after another, each collecting its lines from wherever they are */
+    for(uint64_t i = 0; i < ci->section_cnt; i++)
+    {
+        compiler_section_t *sect = &(ci->section[order[i]]);
+
+        if(sect->kind == COMPILER_SECTION_KIND_BSS)
+        {
+            section_emit_bss(ci, order[i]);
+            continue;
+        }
+
+        if(sect->base != 0)
+        {
+            if(sect->base >= sizeof(ci->image))
+            {
+                diag_error(NULL, "section \"%s\" cannot start at 0x%lx, the image holds at most 0x%lx bytes\n", sect->name, sect->base, sizeof(ci->image));
+            }
+
+            if(sect->base < ci->image_addr)
+            {
+                diag_error(NULL, "section \"%s\" cannot start at 0x%lx, the image is at 0x%lx already\n", sect->name, sect->base, ci->image_addr);
+            }
+
+            memset(&(ci->image[ci->image_addr]), 0, sect->base - ci->image_addr);
+            ci->image_addr = sect->base;
+        }
+
+        if(sect->align > 1)
+        {
+            code_image_align(ci, NULL, sect->align, (sect->kind == COMPILER_SECTION_KIND_CODE) ? LA64_OPCODE_NOP : 0);
+        }
+
+        if(sect->kind == COMPILER_SECTION_KIND_CODE)
+        {
+            la64_compiler_lowsection(ci, order[i]);
+        }
+        else
+        {
+            section_emit_data(ci, order[i]);
+        }
+    }
+
+    code_resource_drop(ci, order);
+}
+
+void code_token_section_place_bss(compiler_invocation_t *ci)
+{
+    /* without a .bss there is nothing to place, and no gap to zero */
+    if(ci->bss_label_cnt == 0 && ci->bss_size == 0)
+    {
+        return;
+    }
+
+    /* .bss starts behind everything that is in the image, aligned to the largest alignment it asked for */
+    uint64_t align = (ci->bss_align > 8) ? ci->bss_align : 8;
+    uint64_t base = (ci->image_addr + align - 1) & ~(align - 1);
+
+    for(uint64_t i = 0; i < ci->bss_label_cnt; i++)
+    {
+        ci->label[ci->bss_label[i]].addr += base;
+    }
+
+    /* the loader zeroes from the end of the image, so the gap to the base counts too */
+    ci->bss_size += base - ci->image_addr;
+}
+
+void code_token_section_insert_bss(compiler_invocation_t *ci)
+{
+    /* writing the size of .bss into the image header */
+    bitwalker_t bw;
+    bitwalker_init(&bw, &(ci->image[COMPILER_IMAGE_HEADER_BSS]), 8, BW_LITTLE_ENDIAN);
+    bitwalker_write(&bw, ci->bss_size, 64);
+}
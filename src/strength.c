@@ -0,0 +1,104 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2024 cr4zyengineer
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <la64asm/strength.h>
+#include <la64asm/opcode.h>
+#include <la64asm/diag.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+
+static inline bool strength_is_pow2(uint64_t value)
+{
+    return value != 0 && (value & (value - 1)) == 0;
+}
+
+void code_ir_strength_reduce(compiler_invocation_t *ci)
+{
+    /* checking if the pass was requested in the first place */
+    if(!(ci->opt->flags & COMPILER_FLAG_STRENGTH_REDUCE))
+    {
+        return;
+    }
+
+    compiler_ir_t *ir = &(ci->ir);
+
+    for(uint64_t i = 0; i < ir->instr_cnt; i++)
+    {
+        /* only a destination and a immediate source is of interest */
+        if(ir->operand_cnt[i] < 2 ||
+           (ir->opcode[i] != LA64_OPCODE_MUL &&
+            ir->opcode[i] != LA64_OPCODE_DIV &&
+            ir->opcode[i] != LA64_OPCODE_MOD))
+        {
+            continue;
+        }
+
+        /* the immediate is always the last operand */
+        uint64_t imm = ir->operand[i] + ir->operand_cnt[i] - 1;
+
+        if(ir->kind[imm] != COMPILER_IR_OPERAND_IMM ||
+           !strength_is_pow2(ir->value[imm]))
+        {
+            continue;
+        }
+
+        /* mul and div (unsigned) by 2^n are shifts, mod by 2^n is a mask, idiv is signed and stays */
+        uint8_t opcode = 0;
+        const char *name = NULL;
+        uint64_t value = 0;
+
+        switch(ir->opcode[i])
+        {
+            case LA64_OPCODE_MUL:
+                opcode = LA64_OPCODE_SHL;
+                name = "shl";
+                value = __builtin_ctzll(ir->value[imm]);
+                break;
+            case LA64_OPCODE_DIV:
+                opcode = LA64_OPCODE_SHR;
+                name = "shr";
+                value = __builtin_ctzll(ir->value[imm]);
+                break;
+            case LA64_OPCODE_MOD:
+                opcode = LA64_OPCODE_AND;
+                name = "and";
+                value = ir->value[imm] - 1;
+                break;
+            default:
+                break;
+        }
+
+        if(ci->opt->flags & COMPILER_FLAG_REPORT)
+        {
+            compiler_line_t *cl = &(ci->line[ir->line[i]]);
+            diag_note(&(cl->token[0]), "strength reduced \"%s %s\" to \"%s %lu\"\n", cl->token[0].str, cl->token[cl->token_cnt - 1].str, name, value);
+        }
+
+        /* rewriting the instruction in place */
+        ir->opcode[i] = opcode;
+        ir->value[imm] = value;
+    }
+}
@@ -0,0 +1,330 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2024 cr4zyengineer
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <la64asm/strip.h>
+#include <la64asm/flow.h>
+#include <la64asm/diag.h>
+#include <la64asm/expr.h>
+#include <la64asm/code.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+
+typedef struct {
+    char *name;                             /* global label or data entry name */
+    uint64_t first;                         /* first line of the node */
+    uint64_t last;                          /* last line of the node (inclusive) */
+    bool data;                              /* node is a section data entry */
+    bool live;                              /* node was reached */
+} strip_node_t;
+
+typedef struct {
+    strip_node_t *node;                     /* nodes in line order */
+    uint64_t node_cnt;                      /* count of nodes */
+    strip_node_t **sorted;                  /* nodes sorted by name */
+    uint64_t *work;                         /* worklist of node indices */
+    uint64_t work_cnt;                      /* count of worklist entries */
+} strip_graph_t;
+
+static int strip_node_compare(const void *a,
+                              const void *b)
+{
+    return strcmp((*(strip_node_t* const*)a)->name, (*(strip_node_t* const*)b)->name);
+}
+
+static strip_node_t *strip_node_lookup(strip_graph_t *sg,
+                                       const char *name)
+{
+    strip_node_t key = { .name = (char*)name };
+    strip_node_t *keyp = &key;
+    strip_node_t **node = bsearch(&keyp, sg->sorted, sg->node_cnt, sizeof(strip_node_t*), strip_node_compare);
+    return (node == NULL) ? NULL : *node;
+}
+
+static void strip_mark(strip_graph_t *sg,
+                       strip_node_t *node)
+{
+    if(node == NULL || node->live)
+    {
+        return;
+    }
+
+    node->live = true;
+    sg->work[sg->work_cnt++] = node - sg->node;
+}
+
+static void strip_mark_name(strip_graph_t *sg,
+                            const char *name)
+{
+    strip_node_t *node = strip_node_lookup(sg, name);
+
+    if(node == NULL)
+    {
+        /* scoped local label, the global part owns it */
+        const char *dot = strchr(name + 1, '.');
+
+        if(dot != NULL)
+        {
+            char *global = strndup(name, dot - name);
+            node = strip_node_lookup(sg, global);
+            free(global);
+        }
+    }
+
+    strip_mark(sg, node);
+}
+
+static void strip_mark_symbol(const char *name,
+                              void *ctx)
+{
+    if(name[0] != '.')
+    {
+        strip_mark_name(ctx, name);
+    }
+}
+
+static void strip_mark_line(strip_graph_t *sg,
+                            compiler_line_t *cl)
+{
+    /* section data refers to labels starting at the third token, assembly after the opcode */
+    uint64_t start = (cl->type == COMPILER_LINE_TYPE_SECTION_DATA) ? 2 : 1;
+
+    for(uint64_t i = start; i < cl->token_cnt; i++)
+    {
+        /* local labels never leave their global label */
+        if(expr_is_expression(cl->token[i].str))
+        {
+            expr_symbols(cl->token[i].str, strip_mark_symbol, sg);
+        }
+        else if(cl->token[i].str[0] != '.' && flow_token_is_label(&(cl->token[i])))
+        {
+            strip_mark_name(sg, cl->token[i].str);
+        }
+    }
+}
+
+static void strip_build(compiler_invocation_t *ci,
+                        strip_graph_t *sg)
+{
+    /* counting nodes */
+    sg->node_cnt = 0;
+    for(uint64_t i = 0; i < ci->line_cnt; i++)
+    {
+        if(ci->line[i].type == COMPILER_LINE_TYPE_GLOBAL_LABEL ||
+           ci->line[i].type == COMPILER_LINE_TYPE_SECTION_DATA)
+        {
+            sg->node_cnt++;
+        }
+    }
+
+    sg->node = calloc(sg->node_cnt, sizeof(strip_node_t));
+    sg->sorted = calloc(sg->node_cnt, sizeof(strip_node_t*));
+    sg->work = calloc(sg->node_cnt, sizeof(uint64_t));
+    sg->work_cnt = 0;
+
+    /* global labels span until the next global label, data entries are one line */
+    strip_node_t *region = NULL;
+    sg->node_cnt = 0;
+    for(uint64_t i = 0; i < ci->line_cnt; i++)
+    {
+        compiler_line_t *cl = &(ci->line[i]);
+
+        if(cl->type == COMPILER_LINE_TYPE_GLOBAL_LABEL)
+        {
+            if(region != NULL)
+            {
+                region->last = i - 1;
+            }
+
+            region = &(sg->node[sg->node_cnt++]);
+            region->name = strndup(cl->token[0].str, strlen(cl->token[0].str) - 1);
+            region->first = i;
+        }
+        else if(cl->type == COMPILER_LINE_TYPE_SECTION_DATA &&
+                cl->token[0].str[0] != '.')
+        {
+            strip_node_t *data = &(sg->node[sg->node_cnt++]);
+            data->name = strdup(cl->token[0].str);
+            data->first = i;
+            data->last = i;
+            data->data = true;
+        }
+    }
+
+    if(region != NULL)
+    {
+        region->last = ci->line_cnt - 1;
+    }
+
+    for(uint64_t i = 0; i < sg->node_cnt; i++)
+    {
+        sg->sorted[i] = &(sg->node[i]);
+    }
+
+    qsort(sg->sorted, sg->node_cnt, sizeof(strip_node_t*), strip_node_compare);
+}
+
+static void strip_free(strip_graph_t *sg)
+{
+    for(uint64_t i = 0; i < sg->node_cnt; i++)
+    {
+        free(sg->node[i].name);
+    }
+
+    free(sg->node);
+    free(sg->sorted);
+    free(sg->work);
+}
+
+static void strip_release(void *ptr)
+{
+    strip_free(ptr);
+    free(ptr);
+}
+
+static strip_node_t *strip_next_region(compiler_invocation_t *ci,
+                                       strip_graph_t *sg,
+                                       strip_node_t *node)
+{
+    /* falling through only ever reaches code of the same section */
+    for(strip_node_t *next = node + 1; next < &(sg->node[sg->node_cnt]); next++)
+    {
+        if(!next->data &&
+           ci->line[next->first].section == ci->line[node->first].section)
+        {
+            return next;
+        }
+    }
+
+    return NULL;
+}
+
+void code_token_dead_strip(compiler_invocation_t *ci)
+{
+    /* checking if the pass was requested in the first place */
+    if(!(ci->opt->flags & COMPILER_FLAG_DEAD_STRIP))
+    {
+        return;
+    }
+
+    /* exports may name labels that do not exist, the invocation lets go of the graph then */
+    strip_graph_t *sg = calloc(1, sizeof(strip_graph_t));
+    code_resource_hold(ci, sg, strip_release);
+    strip_build(ci, sg);
+
+    /* rooting at the entry, the exports and whatever lives in front of the first global label */
+    strip_mark_name(sg, "_start");
+
+    bool global = false;
+    for(uint64_t i = 0; i < ci->line_cnt; i++)
+    {
+        compiler_line_t *cl = &(ci->line[i]);
+
+        if(cl->type == COMPILER_LINE_TYPE_EXPORT)
+        {
+            for(uint64_t a = 1; a < cl->token_cnt; a++)
+            {
+                strip_node_t *node = strip_node_lookup(sg, cl->token[a].str);
+
+                if(node == NULL)
+                {
+                    diag_error(&(cl->token[a]), "exported label \"%s\" not found\n", cl->token[a].str);
+                }
+
+                strip_mark(sg, node);
+            }
+        }
+        else if(cl->type == COMPILER_LINE_TYPE_GLOBAL_LABEL)
+        {
+            global = true;
+        }
+        else if(cl->type == COMPILER_LINE_TYPE_ASM && !global)
+        {
+            strip_mark_line(sg, cl);
+        }
+    }
+
+    /* walking everything that is reachable */
+    while(sg->work_cnt > 0)
+    {
+        strip_node_t *node = &(sg->node[sg->work[--sg->work_cnt]]);
+        compiler_line_t *last = NULL;
+
+        for(uint64_t i = node->first; i <= node->last; i++)
+        {
+            compiler_line_t *cl = &(ci->line[i]);
+
+            if((node->data && cl->type == COMPILER_LINE_TYPE_SECTION_DATA) ||
+               (!node->data && cl->type == COMPILER_LINE_TYPE_ASM))
+            {
+                strip_mark_line(sg, cl);
+
+                /* directives like .align do not end a block */
+                if(cl->token[0].str[0] != '.')
+                {
+                    last = cl;
+                }
+            }
+        }
+
+        /* code that does not end in a jump falls through into the next global label */
+        if(!node->data && (last == NULL || !flow_line_ends_block(last)))
+        {
+            strip_mark(sg, strip_next_region(ci, sg, node));
+        }
+    }
+
+    /* dropping everything unreached */
+    for(uint64_t n = 0; n < sg->node_cnt; n++)
+    {
+        strip_node_t *node = &(sg->node[n]);
+
+        if(node->live)
+        {
+            continue;
+        }
+
+        if(ci->opt->flags & COMPILER_FLAG_REPORT)
+        {
+            diag_note(&(ci->line[node->first].token[0]), "stripped unreferenced %s \"%s\"\n", node->data ? "data" : "label", node->name);
+        }
+
+        for(uint64_t i = node->first; i <= node->last; i++)
+        {
+            compiler_line_t *cl = &(ci->line[i]);
+
+            /* sections and their entries inside a code region are nodes of their own */
+            if(cl->type == COMPILER_LINE_TYPE_SECTION ||
+               (!node->data && cl->type == COMPILER_LINE_TYPE_SECTION_DATA))
+            {
+                continue;
+            }
+
+            cl->type = COMPILER_LINE_TYPE_NONE;
+        }
+    }
+
+    code_resource_drop(ci, sg);
+}
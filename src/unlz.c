@@ -0,0 +1,151 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2024 cr4zyengineer
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <la64asm/lz.h>
+
+typedef struct {
+    int fd;                                 /* where the inflated image goes */
+    const char *path;                       /* name of it for errors */
+    bool failed;                            /* a write failed */
+} unlz_out_t;
+
+static void unlz_sink(const uint8_t *data,
+                      size_t len,
+                      void *ctx)
+{
+    unlz_out_t *out = ctx;
+
+    /* pipes take partial writes */
+    while(len > 0 && !out->failed)
+    {
+        ssize_t n = write(out->fd, data, len);
+
+        if(n < 0)
+        {
+            perror(out->path);
+            out->failed = true;
+            return;
+        }
+
+        data += n;
+        len -= n;
+    }
+}
+
+static void usage(const char *name)
+{
+    fprintf(stderr, "Usage: %s [options] <compressed la64 boot image, - for stdin>\n", name);
+    fprintf(stderr, "Options:\n");
+    fprintf(stderr, "  -o <file>            write the image to file instead of stdout\n");
+}
+
+int main(int argc, char *argv[])
+{
+    unlz_out_t out = { .fd = STDOUT_FILENO, .path = "stdout" };
+    const char *path = NULL;
+    const char *output = NULL;
+
+    /* parsing options */
+    for(int i = 1; i < argc; i++)
+    {
+        if(strcmp(argv[i], "-o") == 0 && i + 1 < argc)
+        {
+            output = argv[++i];
+            continue;
+        }
+
+        if((argv[i][0] == '-' && argv[i][1] != '\0') || path != NULL)
+        {
+            usage(argv[0]);
+            return 1;
+        }
+
+        path = argv[i];
+    }
+
+    if(path == NULL)
+    {
+        usage(argv[0]);
+        return 1;
+    }
+
+    int fd = (strcmp(path, "-") == 0) ? STDIN_FILENO : open(path, O_RDONLY);
+
+    if(fd < 0)
+    {
+        perror(path);
+        return 1;
+    }
+
+    if(output != NULL)
+    {
+        out.fd = open(output, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+        out.path = output;
+
+        if(out.fd < 0)
+        {
+            perror(output);
+            return 1;
+        }
+    }
+
+    /* inflating as the image comes in, nothing waits for the whole file */
+    la64_lz_stream_t ls;
+    la64_lz_stream_init(&ls);
+
+    static uint8_t buf[1 << 16];
+    int status = LA64_LZ_MORE;
+    ssize_t n = 0;
+
+    while(status != LA64_LZ_ERROR && !out.failed && (n = read(fd, buf, sizeof(buf))) > 0)
+    {
+        status = la64_lz_stream_feed(&ls, buf, n, unlz_sink, &out);
+    }
+
+    if(n < 0)
+    {
+        perror(path);
+    }
+    else if(status != LA64_LZ_DONE && !out.failed)
+    {
+        fprintf(stderr, "%s: %s compressed la64 boot image\n", path, (status == LA64_LZ_ERROR) ? "corrupt" : "truncated");
+    }
+
+    la64_lz_stream_free(&ls);
+    close(fd);
+
+    if(output != NULL)
+    {
+        close(out.fd);
+    }
+
+    return (status == LA64_LZ_DONE && !out.failed) ? 0 : 1;
+}
@@ -0,0 +1,218 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2024 cr4zyengineer
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <la64asm/watch.h>
+#include <la64asm/compile.h>
+#include <la64asm/cache.h>
+#include <la64asm/diag.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <setjmp.h>
+#include <time.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/inotify.h>
+
+/* editors save in several steps, changes this close together are one rebuild */
+#define WATCH_SETTLE_MS                         20
+#define WATCH_EVENTS                            (IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE | IN_DELETE)
+
+typedef struct {
+    int wd;                                 /* inotify watch descriptor */
+    char *dir;                              /* canonical path of the directory */
+} watch_dir_t;
+
+typedef struct {
+    int fd;                                 /* inotify instance */
+    watch_dir_t *dir;                       /* directories containing an input */
+    uint64_t dir_cnt;                       /* count of directories */
+} watch_t;
+
+static void watch_dirs(watch_t *w,
+                       compiler_cache_t *cc)
+{
+    /* directories are watched instead of files, saving by renaming a new file over the old one replaces the inode */
+    for(uint64_t i = 0; i < cc->file_cnt; i++)
+    {
+        const char *real = cc->file[i]->real;
+        const char *slash = strrchr(real, '/');
+        char *dir = (slash == real) ? strdup("/") : strndup(real, slash - real);
+
+        uint64_t d = 0;
+        for(; d < w->dir_cnt && strcmp(w->dir[d].dir, dir) != 0; d++);
+
+        if(d < w->dir_cnt)
+        {
+            free(dir);
+            continue;
+        }
+
+        int wd = inotify_add_watch(w->fd, dir, WATCH_EVENTS);
+
+        if(wd < 0)
+        {
+            perror(dir);
+            free(dir);
+            continue;
+        }
+
+        w->dir = realloc(w->dir, (w->dir_cnt + 1) * sizeof(watch_dir_t));
+        w->dir[w->dir_cnt].wd = wd;
+        w->dir[w->dir_cnt++].dir = dir;
+    }
+}
+
+static void watch_build(const char **files,
+                        int file_cnt,
+                        const compiler_options_t *opt,
+                        compiler_invocation_t *ci)
+{
+    struct timespec start;
+    struct timespec end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    /* the invocation is cleared after every build, only the files and their tokens are carried over */
+    /* errors end the build, not the watch */
+    jmp_buf env;
+    int status = setjmp(env);
+
+    if(status == 0)
+    {
+        diag_capture(NULL, &env);
+        compile_invocation(ci, files, file_cnt);
+    }
+
+    diag_capture(NULL, NULL);
+    compiler_invocation_reset(ci, opt);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    /* a failed build may not have reached every file, those are kept until a build succeeds */
+    if(status == 0)
+    {
+        cache_prune(ci->cache);
+    }
+
+    double ms = (end.tv_sec - start.tv_sec) * 1e3 + (end.tv_nsec - start.tv_nsec) / 1e6;
+    printf("%s: %s in %.1f ms, waiting for changes\n", opt->output, (status == 0) ? "built" : "failed", ms);
+    fflush(stdout);
+}
+
+static void watch_wait(watch_t *w,
+                       compiler_cache_t *cc)
+{
+    char buf[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+    int timeout = -1;
+
+    /* blocking until an input changed, then until things settled */
+    for(;;)
+    {
+        struct pollfd pfd = { .fd = w->fd, .events = POLLIN };
+        int ready = poll(&pfd, 1, timeout);
+
+        if(ready < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        else if(ready < 0)
+        {
+            perror("poll");
+            exit(EXIT_FAILURE);
+        }
+        else if(ready == 0)
+        {
+            return;
+        }
+
+        ssize_t len = read(w->fd, buf, sizeof(buf));
+
+        if(len < 0 && errno != EINTR)
+        {
+            perror("inotify");
+            exit(EXIT_FAILURE);
+        }
+
+        for(ssize_t off = 0; off < len;)
+        {
+            struct inotify_event *ev = (struct inotify_event*)&buf[off];
+            off += sizeof(struct inotify_event) + ev->len;
+
+            for(uint64_t d = 0; ev->len > 0 && d < w->dir_cnt; d++)
+            {
+                if(w->dir[d].wd != ev->wd)
+                {
+                    continue;
+                }
+
+                /* the directory is canonical, so the joined path compares against the canonical path of an input */
+                char *path = NULL;
+                asprintf(&path, "%s/%s", (strcmp(w->dir[d].dir, "/") == 0) ? "" : w->dir[d].dir, ev->name);
+
+                if(cache_mark_stale(cc, path))
+                {
+                    timeout = WATCH_SETTLE_MS;
+                }
+
+                free(path);
+                break;
+            }
+        }
+    }
+}
+
+void compile_watch(const char **files,
+                   int file_cnt,
+                   const compiler_options_t *opt)
+{
+    watch_t w = { .fd = inotify_init1(IN_CLOEXEC) };
+    compiler_cache_t cc = { 0 };
+
+    if(w.fd < 0)
+    {
+        perror("inotify");
+        exit(EXIT_FAILURE);
+    }
+
+    /* standard input can not be read again on a change */
+    for(int i = 0; i < file_cnt; i++)
+    {
+        if(strcmp(files[i], "-") == 0)
+        {
+            fprintf(stderr, "standard input can not be watched\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    /* building, waiting and rebuilding what changed until interrupted, always in the same invocation */
+    compiler_invocation_t *ci = compiler_invocation_alloc(opt);
+    ci->cache = &cc;
+
+    for(;;)
+    {
+        watch_build(files, file_cnt, opt, ci);
+        watch_dirs(&w, &cc);
+        watch_wait(&w, &cc);
+    }
+}
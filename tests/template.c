@@ -0,0 +1,282 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2024 cr4zyengineer
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <lautils/bitwalker.h>
+#include <la64asm/type.h>
+#include <la64asm/compile.h>
+#include <la64asm/compiler.h>
+#include <la64asm/opcode.h>
+#include <la64asm/template.h>
+
+/* checks every template against the bitwalker encoding it replaces */
+
+#define TEST_OPERAND_MAX                        3
+#define TEST_BUFFER_SIZE                        512
+
+typedef struct {
+    uint8_t kind;                           /* COMPILER_IR_OPERAND_* */
+    uint64_t value;                         /* register, immediate or addend */
+    const char *sym;                        /* label of symbol operands, NULL otherwise */
+    const char *sub;                        /* label subtracted from the symbol, NULL if none */
+} test_operand_t;
+
+static test_operand_t test_operand[64];
+static uint64_t test_operand_cnt = 0;
+
+static compiler_token_t test_token[1 + TEST_OPERAND_MAX];
+static compiler_line_t test_line = { .str = "<test>", .token = test_token, .token_cnt = 1 + TEST_OPERAND_MAX };
+
+static uint64_t test_checked = 0;
+static uint64_t test_failed = 0;
+
+static void test_operand_add(uint8_t kind,
+                             uint64_t value,
+                             const char *sym,
+                             const char *sub)
+{
+    test_operand[test_operand_cnt++] = (test_operand_t){ .kind = kind, .value = value, .sym = sym, .sub = sub };
+}
+
+static void test_operand_init(void)
+{
+    /* each register */
+    for(uint64_t reg = 0; reg <= LA64_REGISTER_MAX; reg++)
+    {
+        test_operand_add(COMPILER_IR_OPERAND_REG, reg, NULL, NULL);
+    }
+
+    /* immediates right at the edges of each width */
+    static const uint64_t boundary[] = {
+        0x0,
+        0xFF,
+        0x100,
+        0xFFFF,
+        0x10000,
+        0xFFFFFFFF,
+        0x100000000,
+        UINT64_MAX
+    };
+
+    for(size_t i = 0; i < sizeof(boundary) / sizeof(boundary[0]); i++)
+    {
+        test_operand_add(COMPILER_IR_OPERAND_IMM, boundary[i], NULL, NULL);
+    }
+
+    /* symbols, plain, with a addend and as a difference */
+    test_operand_add(COMPILER_IR_OPERAND_SYM, 0, "sym", NULL);
+    test_operand_add(COMPILER_IR_OPERAND_SYM, 0xFFFF, "sym", NULL);
+    test_operand_add(COMPILER_IR_OPERAND_SYM, 0, "end", "start");
+}
+
+static uint8_t test_operand_class(const test_operand_t *op)
+{
+    switch(op->kind)
+    {
+        case COMPILER_IR_OPERAND_REG:
+            return LA64_TEMPLATE_REG;
+        case COMPILER_IR_OPERAND_IMM:
+            return la64_template_imm_class(op->value);
+        default:
+            return LA64_TEMPLATE_IMM64;
+    }
+}
+
+static void test_reloc_patch(compiler_invocation_t *ci)
+{
+    /* writing what the linker would, so both encodings must put it at the same bits */
+    for(uint64_t i = 0; i < ci->rtlb_cnt; i++)
+    {
+        bitwalker_write(&(ci->rtlb[i].bw), 0x0123456789ABCDEF + i, 64);
+    }
+}
+
+static void test_dump(const char *name,
+                      const uint8_t *buf,
+                      uint64_t len)
+{
+    fprintf(stderr, "    %-10s", name);
+
+    for(uint64_t i = 0; i < len; i++)
+    {
+        fprintf(stderr, " %02x", buf[i]);
+    }
+
+    fprintf(stderr, "\n");
+}
+
+static void test_fail(const opcode_entry_t *opce,
+                      test_operand_t **op,
+                      uint8_t cnt,
+                      const char *why)
+{
+    test_failed++;
+
+    fprintf(stderr, "%s:", opce->name);
+
+    for(uint8_t i = 0; i < cnt; i++)
+    {
+        switch(op[i]->kind)
+        {
+            case COMPILER_IR_OPERAND_REG:
+                fprintf(stderr, " reg(%lu)", op[i]->value);
+                break;
+            case COMPILER_IR_OPERAND_IMM:
+                fprintf(stderr, " imm(0x%lx)", op[i]->value);
+                break;
+            default:
+                fprintf(stderr, " sym(%s%s%s+0x%lx)", op[i]->sym, (op[i]->sub != NULL) ? "-" : "", (op[i]->sub != NULL) ? op[i]->sub : "", op[i]->value);
+                break;
+        }
+    }
+
+    fprintf(stderr, " %s\n", why);
+}
+
+static void test_check(compiler_invocation_t *ci,
+                       const opcode_entry_t *opce,
+                       test_operand_t **op,
+                       uint8_t cnt)
+{
+    compiler_ir_t *ir = &(ci->ir);
+
+    ir->opcode[0] = opce->opcode;
+    ir->operand_cnt[0] = cnt;
+
+    for(uint8_t i = 0; i < cnt; i++)
+    {
+        ir->kind[i] = op[i]->kind;
+        ir->value[i] = op[i]->value;
+        ir->sym[i] = op[i]->sym;
+        ir->sub[i] = op[i]->sub;
+    }
+
+    /* template first, it may not fit */
+    uint8_t tmpl[TEST_BUFFER_SIZE] = { 0 };
+    ci->rtlb_cnt = 0;
+    uint64_t tmpl_len = la64_compiler_encode_template(ci, 0, tmpl, true);
+    uint64_t tmpl_reloc = ci->rtlb_cnt;
+    test_reloc_patch(ci);
+
+    uint8_t ref[TEST_BUFFER_SIZE] = { 0 };
+    ci->rtlb_cnt = 0;
+    uint64_t ref_len = la64_compiler_encode_bitwalker(ci, 0, ref, true);
+    uint64_t ref_reloc = ci->rtlb_cnt;
+    test_reloc_patch(ci);
+
+    test_checked++;
+
+    /* only more than two operands or two 64bit ones are left to the bitwalker */
+    bool bare = (opce->opcode == LA64_OPCODE_HLT || opce->opcode == LA64_OPCODE_NOP || opce->opcode == LA64_OPCODE_RET);
+    bool fallback = !bare && (cnt > 2 || (cnt == 2 && test_operand_class(op[0]) == LA64_TEMPLATE_IMM64 && test_operand_class(op[1]) == LA64_TEMPLATE_IMM64));
+
+    if(tmpl_len == 0)
+    {
+        if(!fallback)
+        {
+            test_fail(opce, op, cnt, "has no template");
+        }
+
+        return;
+    }
+
+    if(fallback)
+    {
+        test_fail(opce, op, cnt, "has a template where none fits");
+        return;
+    }
+
+    if(tmpl_len != ref_len || tmpl_reloc != ref_reloc || memcmp(tmpl, ref, ref_len) != 0)
+    {
+        test_fail(opce, op, cnt, "encodes differently");
+        fprintf(stderr, "    length %lu vs %lu, relocations %lu vs %lu\n", tmpl_len, ref_len, tmpl_reloc, ref_reloc);
+        test_dump("template", tmpl, tmpl_len);
+        test_dump("bitwalker", ref, ref_len);
+    }
+}
+
+static void test_shape(compiler_invocation_t *ci,
+                       const opcode_entry_t *opce,
+                       test_operand_t **op,
+                       uint8_t depth,
+                       uint8_t cnt)
+{
+    if(depth == cnt)
+    {
+        test_check(ci, opce, op, cnt);
+        return;
+    }
+
+    for(uint64_t i = 0; i < test_operand_cnt; i++)
+    {
+        op[depth] = &(test_operand[i]);
+        test_shape(ci, opce, op, depth + 1, cnt);
+    }
+}
+
+int main(void)
+{
+    compiler_options_t opt = { 0 };
+    compiler_invocation_t *ci = compiler_invocation_alloc(&opt);
+
+    /* a single instruction lowered from a single line, relocations point at its tokens */
+    ci->ir.line = calloc(1, sizeof(uint64_t));
+    ci->ir.opcode = calloc(1, sizeof(uint8_t));
+    ci->ir.operand_cnt = calloc(1, sizeof(uint8_t));
+    ci->ir.operand = calloc(1, sizeof(uint64_t));
+    ci->ir.kind = calloc(TEST_OPERAND_MAX, sizeof(uint8_t));
+    ci->ir.value = calloc(TEST_OPERAND_MAX, sizeof(uint64_t));
+    ci->ir.sym = calloc(TEST_OPERAND_MAX, sizeof(const char*));
+    ci->ir.sub = calloc(TEST_OPERAND_MAX, sizeof(const char*));
+    ci->ir.instr_cnt = 1;
+    ci->ir.value_cnt = TEST_OPERAND_MAX;
+
+    test_line.ci = ci;
+    ci->line = &test_line;
+
+    test_operand_init();
+
+    /* every opcode in every shape up to one operand more than a template takes */
+    for(uint64_t i = 0; i <= LA64_OPCODE_MAX; i++)
+    {
+        test_operand_t *op[TEST_OPERAND_MAX];
+
+        for(uint8_t cnt = 0; cnt <= TEST_OPERAND_MAX; cnt++)
+        {
+            test_shape(ci, &(opcode_table[i]), op, 0, cnt);
+        }
+    }
+
+    /* the line is not owned by the invocation */
+    ci->line = NULL;
+    compiler_invocation_dealloc(ci);
+
+    printf("%lu encodings checked, %lu failed\n", test_checked, test_failed);
+
+    return (test_failed == 0) ? 0 : 1;
+}